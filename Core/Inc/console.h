@@ -0,0 +1,52 @@
+#ifndef CONSOLE_H_
+#define CONSOLE_H_
+
+#include <stdint.h>
+#include "task.h"
+
+/*
+ * Command console on USART1.
+ *
+ * Received bytes are queued by the USART1 interrupt, a complete line wakes the
+ * console task through its notification word. The task runs as a sporadic EDF
+ * task with a long deadline, so commands are served in slack time without
+ * halting the system:
+ *
+ *   ps                  task states, deadlines, measured load and misses
+ *   stats               uptime, CPU load, criticality mode and log level
+ *   trace dump          scheduler events in the trace ring, oldest first
+ *   latency [reset]     latency histograms (ENABLE_LATENCY_STATS), or clear them
+ *   set loglevel LEVEL  runtime log level, by name or number
+ *   help
+ *
+ * The console does not echo, use the local echo of the terminal.
+ */
+
+/* Minimum time between two commands and their relative deadline, enforced by the console task */
+#ifndef CONSOLE_PERIOD
+#define CONSOLE_PERIOD MS_TO_TICKS(1000)
+#endif
+
+/* Declared execution time of one command, the 115200 baud output dominates */
+#ifndef CONSOLE_EXECUTION_TIME
+#define CONSOLE_EXECUTION_TIME MS_TO_TICKS(50)
+#endif
+
+/* Stack size (in words) of the console task */
+#ifndef CONSOLE_STACK_SIZE
+#define CONSOLE_STACK_SIZE 512
+#endif
+
+/* Received bytes not yet read by the console task, a power of two */
+#ifndef CONSOLE_RX_SIZE
+#define CONSOLE_RX_SIZE 64
+#endif
+
+_Static_assert((CONSOLE_RX_SIZE & (CONSOLE_RX_SIZE - 1)) == 0, "CONSOLE_RX_SIZE must be a power of two");
+
+/* Longest command line */
+#define CONSOLE_LINE_SIZE 48
+
+void console_init(void);
+
+#endif /* CONSOLE_H_ */
@@ -0,0 +1,32 @@
+#ifndef CPU_LOAD_H_
+#define CPU_LOAD_H_
+
+#include <stdint.h>
+#include "task.h"
+
+/* Measurement windows */
+#define CPU_LOAD_SHORT 0
+#define CPU_LOAD_LONG 1
+#define CPU_LOAD_NUM_WINDOWS 2
+
+/* Window lengths in system ticks */
+#ifndef CPU_LOAD_SHORT_WINDOW
+#define CPU_LOAD_SHORT_WINDOW MS_TO_TICKS(100)
+#endif
+
+#ifndef CPU_LOAD_LONG_WINDOW
+#define CPU_LOAD_LONG_WINDOW MS_TO_TICKS(1000)
+#endif
+
+/* Loads are reported in permille (0.1 %) */
+#define CPU_LOAD_SCALE 1000
+
+void cpu_load_update(uint32_t now);
+uint32_t cpu_load_next_update(void);
+uint16_t cpu_load_get_task(uint8_t window, uint8_t task_id);
+uint16_t cpu_load_get_declared(uint8_t task_id);
+uint16_t cpu_load_get_total(uint8_t window);
+bool cpu_load_report_pending(void);
+void cpu_load_report(void);
+
+#endif /* CPU_LOAD_H_ */
@@ -0,0 +1,45 @@
+#ifndef DLOG_H_
+#define DLOG_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Deferred logging.
+ *
+ * With ENABLE_DEFERRED_LOG, DLOG() does not format on the target. The format
+ * string is placed in the .log_strings section, which the linker keeps in the
+ * ELF file but not in flash, and its offset there is sent as the message id
+ * followed by the raw arguments:
+ *
+ *   DLOG_SYNC | id (2 bytes) | argument count (1 byte) | arguments (4 bytes each)
+ *
+ * all little endian. Tools/log_decode.py rebuilds the text from the ELF file.
+ * The id has 16 bits, the linker script fails the link if the format strings
+ * outgrow 64 KiB.
+ * Arguments must be 32-bit values, %s arguments must point to strings in flash.
+ * Without ENABLE_DEFERRED_LOG, DLOG() is plain printf().
+ */
+
+/* First byte of a frame, never part of the ASCII text printed next to it */
+#define DLOG_SYNC 0xA5
+
+#define DLOG_MAX_ARGS 8
+
+/* Number of arguments after the format string, 0 to 8 */
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define DLOG_NARGS(...) DLOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+
+#ifdef ENABLE_DEFERRED_LOG
+#define DLOG(fmt, ...) \
+    do { \
+        static const char dlog_fmt_[] __attribute__((section(".log_strings"), used)) = fmt; \
+        dlog_write((uint32_t)dlog_fmt_, DLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__); \
+    } while (0)
+#else
+#define DLOG(fmt, ...) printf(fmt, ##__VA_ARGS__)
+#endif /* ENABLE_DEFERRED_LOG */
+
+void dlog_write(uint32_t id, uint32_t nargs, ...);
+
+#endif /* DLOG_H_ */
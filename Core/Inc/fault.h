@@ -0,0 +1,17 @@
+#ifndef FAULT_H_
+#define FAULT_H_
+
+/*
+ * Fault capture.
+ *
+ * The fault handlers save the stacked exception frame, the fault status
+ * registers, the running task and the scheduler trace into a record in
+ * .noinit RAM and reset the system. fault_report_last() prints the record
+ * on the next boot, so a field failure can be diagnosed without a debugger.
+ * Define FAULT_HALT_ON_FAULT to stop in the handler instead of resetting.
+ */
+
+void fault_entry(void);
+void fault_report_last(void);
+
+#endif /* FAULT_H_ */
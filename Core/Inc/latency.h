@@ -0,0 +1,74 @@
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Interrupt latency and jitter measurement.
+ *
+ * The DWT cycle counter timestamps three points of the scheduler and each
+ * measurement goes into a histogram:
+ *
+ *   tick entry    TIM2 compare match to the start of the scheduler tick handler,
+ *                 includes the exception entry and the HAL interrupt dispatch
+ *   tick handler  run time of the scheduler tick handler
+ *   switch        PendSV pended to the switched in task's context restored,
+ *                 includes the time the request waits for interrupts to be enabled
+ *
+ * The compare match time is not visible to software. It is derived from the
+ * compare value through a reference point that pairs a TIM2 counter edge with
+ * a cycle count. Both TIM2 and the core run from the PLL, so the tick entry
+ * latency is exact up to the few cycles of the loop that catches the counter
+ * edge, a constant offset that leaves the jitter untouched. Events requested for a time
+ * that had already passed count from the requested time and show up as
+ * outliers. Samples taken across a clock change or STOP mode are dropped and
+ * the reference is taken again.
+ * Enabled with ENABLE_LATENCY_STATS.
+ */
+
+/* Measurements */
+#define LATENCY_TICK_ENTRY 0
+#define LATENCY_TICK_HANDLER 1
+#define LATENCY_SWITCH 2
+#define LATENCY_NUM 3
+
+/* Histogram bucket width, 2^LATENCY_BUCKET_SHIFT cycles */
+#ifndef LATENCY_BUCKET_SHIFT
+#define LATENCY_BUCKET_SHIFT 5
+#endif
+
+/* Number of buckets, longer samples are only counted in the overflow bucket */
+#ifndef LATENCY_BUCKETS
+#define LATENCY_BUCKETS 64
+#endif
+
+/* Summary of one histogram, all times in CPU cycles */
+typedef struct {
+    uint32_t count;     /* Number of samples */
+    uint32_t min;
+    uint32_t max;
+    uint32_t avg;
+    uint32_t p99;       /* Upper edge of the bucket holding the 99th percentile */
+    uint32_t overflow;  /* Samples beyond the last bucket */
+} latency_stats_t;
+
+void latency_init(void);
+void latency_add(uint32_t which, uint32_t cycles);
+bool latency_get(uint32_t which, latency_stats_t *stats);
+void latency_reset(void);
+void latency_report(void);
+const char *latency_name(uint32_t which);
+
+void latency_tick_enter(void);
+void latency_tick_exit(void);
+void latency_switch_requested(void);
+void latency_switch_done(void);
+
+/* Current CPU cycle count, wraps around */
+static inline uint32_t latency_cycles(void) {
+    return DWT->CYCCNT;
+}
+
+#endif /* LATENCY_H_ */
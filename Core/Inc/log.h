@@ -0,0 +1,66 @@
+#ifndef LOG_H_
+#define LOG_H_
+
+#include <stdint.h>
+#include "dlog.h"
+
+/*
+ * Leveled logging.
+ *
+ * A message is sent when its level is within both the compile-time threshold of
+ * its module and the runtime level. Messages above the compile-time threshold
+ * are removed by the compiler, so a build with -DLOG_LEVEL=LOG_LEVEL_NONE has no
+ * logging code left at all. The runtime level starts at LOG_LEVEL_TRACE, so by
+ * default only the compile-time thresholds filter, log_set_level() can only
+ * lower or raise it within what is compiled in.
+ *
+ * LOG_LEVEL is the default threshold of every module, a module reads its own
+ * threshold into LOG_MODULE_LEVEL before including this header:
+ *
+ *   #ifndef LOG_LEVEL_TASK
+ *   #define LOG_LEVEL_TASK LOG_LEVEL
+ *   #endif
+ *   #define LOG_MODULE_LEVEL LOG_LEVEL_TASK
+ *   #include "log.h"
+ *
+ * so that e.g. -DLOG_LEVEL=LOG_LEVEL_WARN -DLOG_LEVEL_TASK=LOG_LEVEL_TRACE keeps
+ * only the scheduler verbose.
+ */
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1   /* The system does not work as configured (deadline miss) */
+#define LOG_LEVEL_WARN 2    /* Unexpected but handled (admission rejected, mode change) */
+#define LOG_LEVEL_INFO 3    /* Task and scheduler life cycle */
+#define LOG_LEVEL_DEBUG 4   /* Context switches */
+#define LOG_LEVEL_TRACE 5   /* Task states at every context switch */
+
+/* Default compile-time threshold */
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#ifndef LOG_MODULE_LEVEL
+#define LOG_MODULE_LEVEL LOG_LEVEL
+#endif
+
+#define LOG_AT(level, fmt, ...) \
+    do { \
+        if ((level) <= LOG_MODULE_LEVEL && (level) <= log_level) { \
+            DLOG(fmt, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_ERROR(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...) LOG_AT(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...) LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define LOG_TRACE(fmt, ...) LOG_AT(LOG_LEVEL_TRACE, fmt, ##__VA_ARGS__)
+
+/* Runtime level, messages above it are skipped */
+extern volatile uint8_t log_level;
+
+void log_set_level(uint8_t level);
+uint8_t log_get_level(void);
+const char *log_level_str(uint8_t level);
+
+#endif /* LOG_H_ */
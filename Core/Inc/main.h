@@ -33,11 +33,7 @@ extern "C" {
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-#ifdef ENABLE_DEBUG_LOG
-#define DEBUG_LOG(...) printf(__VA_ARGS__)
-#else
-#define DEBUG_LOG(...)
-#endif /* ENABLE_DEBUG_LOG */
+
 /* USER CODE END Includes */
 
 /* Exported types ------------------------------------------------------------*/
@@ -58,6 +54,8 @@ extern "C" {
 /* Exported functions prototypes ---------------------------------------------*/
 
 /* USER CODE BEGIN EFP */
+void SystemClock_Config(void);
+void vector_table_to_ram(void);
 
 /* USER CODE END EFP */
 
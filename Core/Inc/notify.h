@@ -0,0 +1,39 @@
+#ifndef NOTIFY_H_
+#define NOTIFY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "task.h"
+
+/*
+ * Task notifications and event groups.
+ *
+ * Every task has a 32-bit notification word that other tasks and interrupts
+ * set bits in. A task waiting for bits sleeps in TASK_WAITING and is released
+ * as a new job with deadline now + deadline_period when a matching bit is set,
+ * so a HAL completion callback can hand work to a task without polling.
+ *
+ * Event groups are shared bit sets several tasks can wait on.
+ * All set functions are safe to call from interrupts. Releasing a waiting task
+ * is O(1), its deadline is sorted into the deadline queue by the next tick.
+ */
+
+/* Waiting tasks are kept as a bit mask */
+_Static_assert(MAX_TASKS <= 32, "notify.c keeps waiting tasks in a 32-bit mask");
+
+typedef struct {
+    volatile uint32_t bits;       /* Current event bits */
+    volatile uint32_t waiters;    /* Bit i is set while task i waits on the group */
+} event_group_t;
+
+#define EVENT_GROUP_INIT { 0, 0 }
+
+void notify_give(uint8_t task_id, uint32_t bits);
+uint32_t notify_wait(uint32_t mask);
+void notify_clear(uint8_t task_id);
+
+void event_group_set(event_group_t *group, uint32_t bits);
+void event_group_clear(event_group_t *group, uint32_t bits);
+uint32_t event_group_wait(event_group_t *group, uint32_t mask, bool wait_all, bool clear_on_exit);
+
+#endif /* NOTIFY_H_ */
@@ -0,0 +1,41 @@
+#ifndef POWER_H_
+#define POWER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "timer2_tick.h"
+
+/* Idle sleep depths */
+#define POWER_SLEEP 0           /* WFI, TIM2 and the tick interrupt keep running */
+#define POWER_STOP 1            /* STOP mode, clocks halted, woken by the RTC wakeup timer */
+#define POWER_NUM_DEPTHS 2
+
+/*
+ * STOP mode is only used when IDLE_ENABLE_STOP_MODE is defined. While stopped
+ * TIM2 does not count, so the scheduler time is advanced by the programmed RTC
+ * wakeup time afterwards; the RTC runs from the LSI, which is calibrated against
+ * TIM2 by power_init(). The RTC wakeup timer must be the only wake-up source.
+ */
+
+/* Shortest idle period (in ticks) worth entering STOP mode for */
+#ifndef IDLE_STOP_MIN_TICKS
+#define IDLE_STOP_MIN_TICKS (10 * (TIMER2_COUNTER_HZ / 1000))
+#endif
+
+/* Time (in ticks) needed to restart HSE and PLL after STOP, the RTC wakes up this much early */
+#ifndef IDLE_STOP_EXIT_TICKS
+#define IDLE_STOP_EXIT_TICKS (3 * (TIMER2_COUNTER_HZ / 1000))
+#endif
+
+/* Idle statistics, residency over time gives the average power draw */
+typedef struct {
+    uint32_t entries[POWER_NUM_DEPTHS];      /* Times each sleep depth was entered */
+    uint64_t residency[POWER_NUM_DEPTHS];    /* Ticks spent in each sleep depth */
+    uint32_t max_wakeup_latency;             /* Largest delay past the planned wake-up time, in ticks */
+} power_stats_t;
+
+void power_init(void);
+void power_idle(bool has_wake_time, uint32_t wake_time);
+void power_get_stats(power_stats_t *stats);
+
+#endif /* POWER_H_ */
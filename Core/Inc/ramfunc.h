@@ -0,0 +1,20 @@
+#ifndef RAMFUNC_H_
+#define RAMFUNC_H_
+
+/*
+ * Placement of the kernel hot path.
+ *
+ * With ENABLE_RAMFUNC (release profile) functions marked RAMFUNC are linked
+ * into .RamFunc, which the startup code copies to SRAM together with .data.
+ * They run without flash wait states, so the tick and the context switch do
+ * not depend on hits in the flash accelerator cache. CCMRAM is not connected
+ * to the instruction bus and cannot hold code. Calls between SRAM and flash
+ * go through linker generated veneers.
+ */
+#ifdef ENABLE_RAMFUNC
+#define RAMFUNC __attribute__((section(".RamFunc")))
+#else
+#define RAMFUNC
+#endif
+
+#endif /* RAMFUNC_H_ */
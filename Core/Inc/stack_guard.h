@@ -0,0 +1,31 @@
+#ifndef STACK_GUARD_H_
+#define STACK_GUARD_H_
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+
+/*
+ * MPU stack guard.
+ *
+ * One MPU region covers the lowest STACK_GUARD_SIZE bytes of the running
+ * task's stack with no access. The context switch moves it to the stack of
+ * the task being switched in, so an overflow faults on the first write past
+ * the stack and the fault handler knows which task overflowed.
+ * Enabled with ENABLE_STACK_GUARD, stacks must be aligned to STACK_GUARD_SIZE.
+ */
+
+/* MPU region used for the guard */
+#define STACK_GUARD_REGION 0
+
+/* Smallest MPU region, the usable stack is this much smaller */
+#define STACK_GUARD_SIZE 32
+
+void stack_guard_init(void);
+void stack_guard_report_fault(void);
+
+/* Move the guard to the bottom of the given stack, only the region base changes */
+static inline void stack_guard_set(const uint32_t *stack_base) {
+    MPU->RBAR = (uint32_t)stack_base | MPU_RBAR_VALID_Msk | STACK_GUARD_REGION;
+}
+
+#endif /* STACK_GUARD_H_ */
@@ -1,4 +1,6 @@
 #include "stm32f4xx.h"
+#include "timer2_tick.h"
+#include <stdbool.h>
 
 #ifndef TASK_H_
 #define TASK_H_
@@ -6,30 +8,146 @@
 /* Task states */
 #define TASK_READY 0
 #define TASK_RUNNING 1
-#define TASK_BLOCKED 2
+#define TASK_BLOCKED 2    /* Waiting for wake_time */
+#define TASK_WAITING 3    /* Waiting for task_wake(), no timeout */
+#define TASK_SUSPENDED 4  /* Stopped by task_suspend() until task_resume() */
+#define TASK_FREE 5       /* Unused slot, left behind by task_delete() */
 
+/* Task criticality levels, also the scheduler criticality modes */
+#define TASK_CRIT_LO 0
+#define TASK_CRIT_HI 1
+
+/* Scheduler time base: one system tick is one TIM2 counter tick (1 us by default) */
+#define TICKS_PER_MS (TIMER2_COUNTER_HZ / 1000)
+#define MS_TO_TICKS(ms) ((uint32_t)(ms) * TICKS_PER_MS)
+#define US_TO_TICKS(us) ((uint32_t)((uint64_t)(us) * TIMER2_COUNTER_HZ / 1000000))
+
+/* What happens to a job that misses its deadline */
+#define TASK_MISS_HALT 0        /* Report and assert (default) */
+#define TASK_MISS_ABORT 1       /* Drop the job and restart the task at its next release */
+#define TASK_MISS_CONTINUE 2    /* Let the job finish late, task_is_late() tells it */
+#define TASK_MISS_CALLBACK 3    /* Ask the task's miss handler, it returns one of the above */
+
+/* Called from the tick interrupt with the id of the late task */
+typedef uint32_t (*task_miss_handler_t)(uint8_t task_id);
+
+/* Period and deadline value of tasks without a deadline (idle task) */
+#define TASK_NO_DEADLINE 0xFFFFFFFF
+
+/* Default stack size (in words) for tasks created with create_task() */
+#ifndef STACK_SIZE
 #define STACK_SIZE  1024
+#endif
+
+/* Smallest stack (in words) a task may be given */
+#define TASK_MIN_STACK_SIZE 64
+
+/* Stack size (in words) of the idle task */
+#ifndef IDLE_STACK_SIZE
+#define IDLE_STACK_SIZE 256
+#endif
 
 /* Maximum number of tasks */
+#ifndef MAX_TASKS
 #define MAX_TASKS 10
+#endif
+
+/* Number of STACK_SIZE stacks reserved for create_task(),
+ * tasks declared in a static task table (task_table.h) bring their own stack */
+#ifndef TASK_STACK_POOL_SIZE
+#define TASK_STACK_POOL_SIZE MAX_TASKS
+#endif
+
+/* Alignment of task stacks, the MPU stack guard needs them aligned to its region size */
+#ifdef ENABLE_STACK_GUARD
+#define TASK_STACK_ALIGN 32
+#else
+#define TASK_STACK_ALIGN 8
+#endif
 
 /* Task control block */
 typedef struct {
     uint32_t *stack_ptr;         /* Stack pointer */
-    uint32_t stack[STACK_SIZE];  /* Task stack */
+    uint32_t *stack_base;        /* Lowest address of the task stack */
+    uint32_t stack_size;         /* Task stack size in words */
     uint32_t state;              /* Task state */
     uint32_t period;             /* Task period in system ticks */
     uint32_t deadline;           /* Absolute deadline */
     uint32_t deadline_period;    /* Deadline period from moment of starting execution */
-    uint32_t execution_time;     /* Worst-case execution time */
-    uint32_t wait_time;          /* Ticks to wait before resuming execution */
+    uint32_t execution_time;     /* Worst-case execution time, optimistic (LO) budget of HI tasks */
+    uint32_t execution_time_hi;  /* Pessimistic worst-case execution time of HI tasks */
+    uint32_t criticality;        /* TASK_CRIT_LO or TASK_CRIT_HI */
+    uint32_t virtual_deadline_period;  /* Relative deadline used for scheduling in LO mode (EDF-VD) */
+    uint32_t job_run_time;       /* Ticks the current job has been running */
+    uint32_t npr_length;         /* Longest time a preemption of this task is deferred, 0 = fully preemptive */
+    uint32_t npr_end;            /* End of the active non-preemptive region */
+    bool npr_active;             /* A preemption is being deferred */
+    uint32_t miss_policy;        /* TASK_MISS_* */
+    task_miss_handler_t miss_handler;  /* Handler of TASK_MISS_CALLBACK */
+    uint32_t miss_count;         /* Number of missed deadlines */
+    bool late;                   /* The current job missed its deadline */
+    bool abort_pending;          /* Restart the task when it is switched out */
+    uint32_t offset;             /* Release time of the first job relative to the scheduler start */
+    uint32_t release_time;       /* Absolute release time of the current or next job */
+    uint32_t wake_time;          /* Absolute time a blocked task becomes ready again */
+    uint32_t run_time;           /* Ticks spent running, wraps around */
     void (*task_func)(void);     /* Task function pointer */
-    char name[256];              /* Task name for debugging */
+    const char *name;            /* Task name for debugging */
 } TCB_t;
 
-int create_task(void (*task_func)(void), uint32_t period, uint32_t execution_time, uint32_t deadline_period, const char *name);
+/* Task parameters, used to create a task on a caller provided stack */
+typedef struct {
+    void (*task_func)(void);     /* Task function pointer */
+    const char *name;            /* Task name, must outlive the task */
+    uint32_t period;             /* Task period in system ticks */
+    uint32_t execution_time;     /* Worst-case execution time */
+    uint32_t deadline_period;    /* Relative deadline */
+    uint32_t offset;             /* First release relative to the scheduler start (phase) */
+    uint32_t npr_length;         /* Non-preemptive region length, 0 = fully preemptive */
+    uint32_t criticality;        /* TASK_CRIT_LO (default) or TASK_CRIT_HI */
+    uint32_t execution_time_hi;  /* Pessimistic WCET of HI tasks, 0 means execution_time */
+    uint32_t miss_policy;        /* TASK_MISS_*, TASK_MISS_HALT by default */
+    task_miss_handler_t miss_handler;  /* Handler of TASK_MISS_CALLBACK */
+    uint32_t *stack;             /* Zero-initialized stack memory */
+    uint32_t stack_size;         /* Stack size in words */
+} task_config_t;
+
+extern TCB_t tasks[MAX_TASKS];
+extern uint8_t num_tasks;
+
+int create_task(void (*task_func)(void), uint32_t period, uint32_t execution_time, uint32_t deadline_period,
+                uint32_t offset, const char *name);
+int create_task_static(const task_config_t *config);
 uint32_t get_tick(void);
 void task_yield(void);
+void task_sleep_until(uint32_t wake_time);
+void task_delay(uint32_t ticks);
+void task_wait(void);
+void task_wake(uint8_t task_id, uint32_t deadline);
+void task_restart_job(uint32_t deadline);
+void task_set_deadline(uint8_t task_id, uint32_t deadline);
+void task_set_criticality(uint8_t task_id, uint32_t criticality, uint32_t execution_time_hi);
+uint32_t task_get_criticality_mode(void);
+void task_set_miss_policy(uint8_t task_id, uint32_t policy, task_miss_handler_t handler);
+uint32_t task_get_miss_count(uint8_t task_id);
+bool task_is_late(void);
+void task_set_npr_length(uint8_t task_id, uint32_t npr_length);
 void start_scheduler(void);
+uint32_t task_get_run_time(uint8_t task_id);
+uint8_t get_idle_task_id(void);
+uint8_t task_get_current_id(void);
+const char *task_get_state_str(uint8_t task_id);
+bool task_delete(uint8_t task_id);
+bool task_suspend(uint8_t task_id);
+bool task_resume(uint8_t task_id);
+
+/* Wrap-safe comparisons of system tick values, valid for times less than 2^31 ticks apart */
+static inline bool time_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+static inline bool time_after_eq(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) >= 0;
+}
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,216 @@
+/*
+ * Compile-time task table.
+ *
+ * Declare the task set with an X-macro before including this header:
+ *
+ *   #define EDF_TASK_TABLE(X) \
+ *       X(task1, "Task1", MS_TO_TICKS(40), MS_TO_TICKS(10), MS_TO_TICKS(40), 0, 512) \
+ *       X(task2, "Task2", US_TO_TICKS(500), US_TO_TICKS(50), US_TO_TICKS(250), US_TO_TICKS(100), 256)
+ *   #define EDF_TASK_TABLE_HYPERPERIOD MS_TO_TICKS(40)
+ *   #include "task_table.h"
+ *
+ * Each entry is X(function, name, period, execution_time, deadline_period, offset, stack_words),
+ * times are in system ticks. The offset delays the first release after start_scheduler(),
+ * Tools/edf_offsets.py suggests offsets that spread the releases.
+ * EDF_TASK_TABLE_HYPERPERIOD is any common multiple of the periods (normally their LCM).
+ *
+ * High-criticality tasks go into the optional EDF_TASK_TABLE_HI(X), each entry is
+ * X(function, name, period, execution_time, execution_time_hi, deadline_period, offset, stack_words)
+ * with the optimistic and the pessimistic WCET. The set is then checked with the
+ * EDF-VD test in addition to the plain EDF test with optimistic budgets.
+ *
+ * The optional EDF_TASK_TABLE_NPR(X) gives tasks a non-preemptive region with
+ * entries X(function, npr_length), see task_set_npr_length(). It is checked by
+ * start_scheduler(), not at compile time.
+ *
+ * EDF_TASK_TABLE_MISS_POLICY sets the deadline miss policy of all table tasks
+ * (TASK_MISS_HALT by default), task_set_miss_policy() changes it per task.
+ *
+ * The header places one exactly sized stack per task in .bss, checks the task set
+ * with static assertions and provides task_table_create() to register the tasks
+ * before start_scheduler(). The build fails if the set is not EDF-schedulable,
+ * unless EDF_TASK_TABLE_SKIP_SCHEDULABILITY_CHECK is defined.
+ *
+ * Include it from a single translation unit only.
+ */
+
+#ifndef TASK_TABLE_H_
+#define TASK_TABLE_H_
+
+#include "task.h"
+
+#ifndef EDF_TASK_TABLE
+#error Define EDF_TASK_TABLE(X) before including task_table.h
+#endif
+
+#ifndef EDF_TASK_TABLE_HYPERPERIOD
+#error Define EDF_TASK_TABLE_HYPERPERIOD before including task_table.h
+#endif
+
+/* Fixed-point scale of the density sum (parts per million) */
+#define EDF_TASK_TABLE_DENSITY_SCALE 1000000ULL
+
+/* Task slots and CPU bandwidth used besides the table: the idle task, the aperiodic server and the console */
+#ifdef ENABLE_TBS
+#include "tbs.h"
+#define EDF_TT_TBS_TASKS 1
+#define EDF_TT_TBS_DENSITY ((uint64_t)TBS_BANDWIDTH * EDF_TASK_TABLE_DENSITY_SCALE / TBS_BANDWIDTH_SCALE)
+#define EDF_TT_TBS_BUSY_TICKS \
+    (((uint64_t)EDF_TASK_TABLE_HYPERPERIOD * TBS_BANDWIDTH + TBS_BANDWIDTH_SCALE - 1) / TBS_BANDWIDTH_SCALE)
+#else
+#define EDF_TT_TBS_TASKS 0
+#define EDF_TT_TBS_DENSITY 0
+#define EDF_TT_TBS_BUSY_TICKS 0
+#endif /* ENABLE_TBS */
+
+#ifdef ENABLE_CONSOLE
+#include "console.h"
+#define EDF_TT_CONSOLE_TASKS 1
+#define EDF_TT_CONSOLE_DENSITY \
+    (((uint64_t)CONSOLE_EXECUTION_TIME * EDF_TASK_TABLE_DENSITY_SCALE + CONSOLE_PERIOD - 1) / CONSOLE_PERIOD)
+#define EDF_TT_CONSOLE_BUSY_TICKS \
+    (((uint64_t)EDF_TASK_TABLE_HYPERPERIOD * CONSOLE_EXECUTION_TIME + CONSOLE_PERIOD - 1) / CONSOLE_PERIOD)
+#else
+#define EDF_TT_CONSOLE_TASKS 0
+#define EDF_TT_CONSOLE_DENSITY 0
+#define EDF_TT_CONSOLE_BUSY_TICKS 0
+#endif /* ENABLE_CONSOLE */
+
+#define EDF_TT_RESERVED_TASKS (1 + EDF_TT_TBS_TASKS + EDF_TT_CONSOLE_TASKS)
+#define EDF_TT_RESERVED_DENSITY (EDF_TT_TBS_DENSITY + EDF_TT_CONSOLE_DENSITY)
+#define EDF_TT_RESERVED_BUSY_TICKS (EDF_TT_TBS_BUSY_TICKS + EDF_TT_CONSOLE_BUSY_TICKS)
+
+#ifndef EDF_TASK_TABLE_HI
+#define EDF_TASK_TABLE_HI(X)
+#endif
+
+#ifndef EDF_TASK_TABLE_NPR
+#define EDF_TASK_TABLE_NPR(X)
+#endif
+
+#ifndef EDF_TASK_TABLE_MISS_POLICY
+#define EDF_TASK_TABLE_MISS_POLICY TASK_MISS_HALT
+#endif
+
+#define EDF_TT_MIN_(a, b) ((a) < (b) ? (a) : (b))
+
+/* Number of tasks in the table */
+#define EDF_TT_COUNT_(f, n, t, c, d, o, s) + 1
+#define EDF_TT_COUNT_HI_(f, n, t, c, ch, d, o, s) + 1
+#define EDF_TASK_TABLE_COUNT (0 EDF_TASK_TABLE(EDF_TT_COUNT_) EDF_TASK_TABLE_HI(EDF_TT_COUNT_HI_))
+
+/* Busy ticks per hyperperiod with optimistic budgets, the utilization is this over the hyperperiod */
+#define EDF_TT_BUSY_(f, n, t, c, d, o, s) \
+    + (uint64_t)(c) * (EDF_TASK_TABLE_HYPERPERIOD / (t))
+#define EDF_TT_BUSY_HI_(f, n, t, c, ch, d, o, s) EDF_TT_BUSY_(f, n, t, c, d, o, s)
+#define EDF_TASK_TABLE_BUSY_TICKS (0 EDF_TASK_TABLE(EDF_TT_BUSY_) EDF_TASK_TABLE_HI(EDF_TT_BUSY_HI_))
+
+/* Sum of C / min(D, T), rounded up per task so the test stays sufficient */
+#define EDF_TT_DENSITY_(f, n, t, c, d, o, s) \
+    + ((uint64_t)(c) * EDF_TASK_TABLE_DENSITY_SCALE + EDF_TT_MIN_(t, d) - 1) \
+        / EDF_TT_MIN_(t, d)
+#define EDF_TT_DENSITY_HI_LO_(f, n, t, c, ch, d, o, s) EDF_TT_DENSITY_(f, n, t, c, d, o, s)
+#define EDF_TT_DENSITY_HI_HI_(f, n, t, c, ch, d, o, s) EDF_TT_DENSITY_(f, n, t, ch, d, o, s)
+#define EDF_TASK_TABLE_DENSITY (0 EDF_TASK_TABLE(EDF_TT_DENSITY_) EDF_TASK_TABLE_HI(EDF_TT_DENSITY_HI_LO_))
+
+/* Densities of the EDF-VD test, the reserved bandwidth counts as low criticality */
+#define EDF_TT_DENSITY_LO (0 EDF_TASK_TABLE(EDF_TT_DENSITY_) + EDF_TT_RESERVED_DENSITY)
+#define EDF_TT_DENSITY_HI_LO (0 EDF_TASK_TABLE_HI(EDF_TT_DENSITY_HI_LO_))
+#define EDF_TT_DENSITY_HI_HI (0 EDF_TASK_TABLE_HI(EDF_TT_DENSITY_HI_HI_))
+
+/* Per task sanity checks */
+#define EDF_TT_CHECK_(f, n, t, c, d, o, s) \
+    _Static_assert((t) > 0 && EDF_TASK_TABLE_HYPERPERIOD % (t) == 0, \
+                   "period of " n " does not divide EDF_TASK_TABLE_HYPERPERIOD"); \
+    _Static_assert((c) <= (d), \
+                   "execution time of " n " exceeds its deadline"); \
+    _Static_assert((s) >= TASK_MIN_STACK_SIZE, \
+                   "stack of " n " is smaller than TASK_MIN_STACK_SIZE"); \
+    _Static_assert((o) < (t), \
+                   "offset of " n " is not less than its period");
+#define EDF_TT_CHECK_HI_(f, n, t, c, ch, d, o, s) \
+    EDF_TT_CHECK_(f, n, t, ch, d, o, s) \
+    _Static_assert((c) <= (ch), \
+                   "optimistic execution time of " n " exceeds its pessimistic one");
+EDF_TASK_TABLE(EDF_TT_CHECK_)
+EDF_TASK_TABLE_HI(EDF_TT_CHECK_HI_)
+
+_Static_assert(EDF_TASK_TABLE_COUNT + EDF_TT_RESERVED_TASKS <= MAX_TASKS,
+               "task table and system tasks do not fit in MAX_TASKS");
+
+#ifndef EDF_TASK_TABLE_SKIP_SCHEDULABILITY_CHECK
+_Static_assert(EDF_TASK_TABLE_BUSY_TICKS + EDF_TT_RESERVED_BUSY_TICKS <= EDF_TASK_TABLE_HYPERPERIOD,
+               "task table utilization exceeds 100%, not EDF-schedulable");
+_Static_assert(EDF_TASK_TABLE_DENSITY + EDF_TT_RESERVED_DENSITY <= EDF_TASK_TABLE_DENSITY_SCALE,
+               "task table density exceeds 1, EDF schedulability not guaranteed");
+/* EDF-VD: x * U_LO(LO) + U_HI(HI) <= 1 with x = U_HI(LO) / (1 - U_LO(LO)), multiplied out */
+_Static_assert(EDF_TT_DENSITY_HI_HI == 0
+               || (EDF_TT_DENSITY_LO < EDF_TASK_TABLE_DENSITY_SCALE
+                   && EDF_TT_DENSITY_HI_LO * EDF_TT_DENSITY_LO
+                      + EDF_TT_DENSITY_HI_HI * (EDF_TASK_TABLE_DENSITY_SCALE - EDF_TT_DENSITY_LO)
+                      <= EDF_TASK_TABLE_DENSITY_SCALE * (EDF_TASK_TABLE_DENSITY_SCALE - EDF_TT_DENSITY_LO)),
+               "mixed-criticality task table fails the EDF-VD test");
+#endif /* EDF_TASK_TABLE_SKIP_SCHEDULABILITY_CHECK */
+
+/* Task functions and their stacks */
+#define EDF_TT_STORAGE_(f, n, t, c, d, o, s) \
+    static void f(void); \
+    static uint32_t f##_stack[s] __attribute__((aligned(TASK_STACK_ALIGN)));
+#define EDF_TT_STORAGE_HI_(f, n, t, c, ch, d, o, s) EDF_TT_STORAGE_(f, n, t, c, d, o, s)
+EDF_TASK_TABLE(EDF_TT_STORAGE_)
+EDF_TASK_TABLE_HI(EDF_TT_STORAGE_HI_)
+
+#define EDF_TT_ENTRY_(f, n, t, c, d, o, s) \
+    { \
+        .task_func = f, \
+        .name = n, \
+        .period = t, \
+        .execution_time = c, \
+        .deadline_period = d, \
+        .offset = o, \
+        .miss_policy = EDF_TASK_TABLE_MISS_POLICY, \
+        .stack = f##_stack, \
+        .stack_size = s, \
+    },
+#define EDF_TT_ENTRY_HI_(f, n, t, c, ch, d, o, s) \
+    { \
+        .task_func = f, \
+        .name = n, \
+        .period = t, \
+        .execution_time = c, \
+        .deadline_period = d, \
+        .offset = o, \
+        .criticality = TASK_CRIT_HI, \
+        .execution_time_hi = ch, \
+        .miss_policy = EDF_TASK_TABLE_MISS_POLICY, \
+        .stack = f##_stack, \
+        .stack_size = s, \
+    },
+static const task_config_t edf_task_table[] = {
+    EDF_TASK_TABLE(EDF_TT_ENTRY_)
+    EDF_TASK_TABLE_HI(EDF_TT_ENTRY_HI_)
+};
+
+/* Position of each task in edf_task_table */
+#define EDF_TT_INDEX_(f, n, t, c, d, o, s) EDF_TT_INDEX_##f,
+#define EDF_TT_INDEX_HI_(f, n, t, c, ch, d, o, s) EDF_TT_INDEX_##f,
+enum {
+    EDF_TASK_TABLE(EDF_TT_INDEX_)
+    EDF_TASK_TABLE_HI(EDF_TT_INDEX_HI_)
+};
+
+#define EDF_TT_NPR_(f, q) task_set_npr_length(task_ids[EDF_TT_INDEX_##f], q);
+
+/* Register every task of the table, call before start_scheduler() */
+static inline void task_table_create(void) {
+    uint8_t task_ids[EDF_TASK_TABLE_COUNT];
+
+    for (uint32_t i = 0; i < EDF_TASK_TABLE_COUNT; i++) {
+        task_ids[i] = create_task_static(&edf_task_table[i]);
+    }
+
+    EDF_TASK_TABLE_NPR(EDF_TT_NPR_)
+    (void)task_ids;
+}
+
+#endif /* TASK_TABLE_H_ */
@@ -0,0 +1,37 @@
+#ifndef TBS_H_
+#define TBS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "task.h"
+
+/*
+ * Total Bandwidth Server for aperiodic jobs.
+ *
+ * A job submitted at time r with execution time C gets the deadline
+ *     d = max(r, d_prev) + C / TBS_BANDWIDTH
+ * and is run by the server task under EDF with that deadline. As long as the
+ * periodic tasks use at most 1 - TBS_BANDWIDTH of the CPU and jobs stay within
+ * their declared execution time, all deadlines are met.
+ */
+
+/* Reserved bandwidth in permille of the CPU */
+#ifndef TBS_BANDWIDTH
+#define TBS_BANDWIDTH 100
+#endif
+#define TBS_BANDWIDTH_SCALE 1000
+
+/* Maximum number of pending jobs */
+#ifndef TBS_QUEUE_SIZE
+#define TBS_QUEUE_SIZE 8
+#endif
+
+/* Stack size (in words) of the server task */
+#ifndef TBS_STACK_SIZE
+#define TBS_STACK_SIZE 512
+#endif
+
+void tbs_init(void);
+bool tbs_submit(void (*job_func)(void *), void *arg, uint32_t execution_time);
+
+#endif /* TBS_H_ */
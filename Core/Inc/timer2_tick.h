@@ -1,7 +1,24 @@
 #ifndef TIMER2_TICK_INT_H
 #define TIMER2_TICK_INT_H
 
+#include <stdint.h>
+
+/* TIM2 counter frequency, this is the resolution of the scheduler time base */
+#ifndef TIMER2_COUNTER_HZ
+#define TIMER2_COUNTER_HZ 1000000
+#endif
+
+/* Longest time between two tick interrupts when nothing is due, in counter ticks (1 s) */
+/* The scheduler otherwise only wakes up for releases, deadlines and budgets */
+#ifndef TIMER2_TICK_INTERVAL
+#define TIMER2_TICK_INTERVAL TIMER2_COUNTER_HZ
+#endif
+
 void timer2_tick_init(void);
 void timer2_set_tick_callback(void (*tick_cb)(void));
+uint32_t timer2_get_counter(void);
+void timer2_set_next_event(uint32_t counter);
+uint32_t timer2_get_next_event(void);
+void timer2_advance(uint32_t counts);
 
-#endif /* TIMER2_TICK_INT_H */
\ No newline at end of file
+#endif /* TIMER2_TICK_INT_H */
@@ -0,0 +1,82 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+#include "stm32f4xx.h"
+
+/*
+ * Scheduler trace.
+ *
+ * A ring of the last TRACE_SIZE scheduler events with their tick time. It is
+ * cheap enough to stay on all the time and is saved with the fault record,
+ * so the events that led to a crash can be read after the reset.
+ *
+ * ENABLE_TRACE_ISR adds entry and exit events of the TIM2, PendSV and USART1
+ * handlers. ENABLE_TRACE_STREAM also sends every event as it is recorded over
+ * USART2 (TX on PA2), as the 8 bytes of trace_event_t. Events are queued and
+ * sent from the USART2 interrupt, so recording stays cheap; when the queue is
+ * full the event is dropped and counted. Renode/trace_capture.resc
+ * saves that stream to a file and Tools/edf_trace.py --binary turns it into a
+ * Chrome/Perfetto trace.
+ */
+
+/* Number of events kept, a power of two */
+#ifndef TRACE_SIZE
+#define TRACE_SIZE 64
+#endif
+
+_Static_assert((TRACE_SIZE & (TRACE_SIZE - 1)) == 0, "TRACE_SIZE must be a power of two");
+
+/* Event types */
+#define TRACE_SWITCH 1      /* task_id switched in, arg is the previous task */
+#define TRACE_RELEASE 2     /* task_id became ready (job release or end of a sleep) */
+#define TRACE_COMPLETE 3    /* Job of task_id finished */
+#define TRACE_MISS 4        /* task_id missed its deadline */
+#define TRACE_MODE 5        /* Criticality mode changed to arg */
+#define TRACE_IRQ_ENTER 6   /* Handler of exception number arg entered */
+#define TRACE_IRQ_EXIT 7    /* Handler of exception number arg returns */
+
+/* Baud rate of the trace stream */
+#ifndef TRACE_STREAM_BAUD
+#define TRACE_STREAM_BAUD 1000000
+#endif
+
+/* Bytes queued for the trace stream, a power of two */
+#ifndef TRACE_STREAM_BUFFER
+#define TRACE_STREAM_BUFFER 1024
+#endif
+
+_Static_assert((TRACE_STREAM_BUFFER & (TRACE_STREAM_BUFFER - 1)) == 0, "TRACE_STREAM_BUFFER must be a power of two");
+
+/* USART2 interrupt priority, the lowest so sending never delays the scheduler */
+#ifndef TRACE_STREAM_IRQ_PRIORITY
+#define TRACE_STREAM_IRQ_PRIORITY 15
+#endif
+
+typedef struct {
+    uint32_t time;          /* System ticks */
+    uint8_t type;           /* TRACE_* */
+    uint8_t task_id;
+    uint16_t arg;
+} trace_event_t;
+
+void trace_record(uint8_t type, uint8_t task_id, uint16_t arg);
+uint32_t trace_snapshot(trace_event_t *events, uint32_t max_events);
+const char *trace_type_str(uint8_t type);
+void trace_stream_init(void);
+uint32_t trace_stream_dropped(void);
+
+/* Call first and last thing in an interrupt handler */
+static inline void trace_isr_enter(void) {
+#ifdef ENABLE_TRACE_ISR
+    trace_record(TRACE_IRQ_ENTER, 0xFF, (uint16_t)__get_IPSR());
+#endif
+}
+
+static inline void trace_isr_exit(void) {
+#ifdef ENABLE_TRACE_ISR
+    trace_record(TRACE_IRQ_EXIT, 0xFF, (uint16_t)__get_IPSR());
+#endif
+}
+
+#endif /* TRACE_H_ */
@@ -1,6 +1,8 @@
 #ifndef UART1_LOGGER_H_
 #define UART1_LOGGER_H_
 
+#include <stdint.h>
+
 #ifdef __GNUC__
   /* With GCC, small printf (option LD Linker->Libraries->Small printf
      set to 'Yes') calls __io_putchar() */
@@ -9,6 +11,13 @@
   #define PUTCHAR_PROTOTYPE int fputc(int ch, FILE *f)
 #endif /* __GNUC__ */
 
+/* USART1 interrupt priority, below the scheduler tick (TICK_INT_PRIORITY) */
+#ifndef UART1_IRQ_PRIORITY
+#define UART1_IRQ_PRIORITY 5
+#endif
+
 void uart1_logger_init(void);
+void uart1_logger_write(const uint8_t *data, uint32_t len);
+void uart1_logger_set_rx_callback(void (*callback)(uint8_t byte));
 
 #endif /* UART1_LOGGER_H_ */
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef WORKLOAD_H_
+#define WORKLOAD_H_
+
+#include <stdint.h>
+
+/* Calibrated CPU burners to simulate job execution time and for benchmarking.
+ * Unlike HAL_Delay() they consume the CPU time of the calling task only, so a
+ * preempted job takes correspondingly longer to finish. */
+
+void workload_calibrate(void);
+void workload_burn_cycles(uint32_t cycles);
+void workload_burn_us(uint32_t us);
+
+#endif /* WORKLOAD_H_ */
@@ -0,0 +1,253 @@
+#include "main.h"
+#include "uart1_logger.h"
+#include "notify.h"
+#include "latency.h"
+#include <stdio.h>
+
+/*
+ * Kernel microbenchmarks, built by `make bench` in place of the demo application.
+ *
+ * Every primitive is timed with the DWT cycle counter and the results are
+ * printed on USART1 as CSV lines starting with "BENCH,", all times in cycles:
+ *
+ *   BENCH,start,core_hz,max_tasks
+ *   BENCH,name,tasks,samples,min,avg,max
+ *   BENCH,create_task,10,106,...
+ *   BENCH,done
+ *
+ * tasks is the number of task slots in use, the task set fills all MAX_TASKS
+ * slots so the per tick cost can be compared between MAX_TASKS values.
+ * Run it headless with Renode/run_bench.resc and compare two runs with
+ * Tools/bench_compare.py.
+ */
+
+/* Samples taken of every benchmark */
+#ifndef BENCH_ROUNDS
+#define BENCH_ROUNDS 100
+#endif
+
+/* Period of the benchmark task, one yield and one wake-up sample per job */
+#define BENCH_PERIOD MS_TO_TICKS(5)
+
+/* Filler tasks only make the task set MAX_TASKS long */
+#define BENCH_FILLER_PERIOD MS_TO_TICKS(100)
+#define BENCH_FILLER_EXECUTION_TIME US_TO_TICKS(50)
+
+/* Benchmark, partner, waiter and idle task */
+#define BENCH_FIXED_TASKS 4
+
+_Static_assert(MAX_TASKS >= BENCH_FIXED_TASKS, "the benchmark needs 4 task slots");
+
+#define BENCH_STACK_SIZE 1024
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} bench_stat_t;
+
+static bench_stat_t create_stat = { .min = UINT32_MAX };
+static bench_stat_t delete_stat = { .min = UINT32_MAX };
+static bench_stat_t queue_stat = { .min = UINT32_MAX };
+static bench_stat_t yield_stat = { .min = UINT32_MAX };
+static bench_stat_t notify_stat = { .min = UINT32_MAX };
+
+/* Written by one task right before the switch, read by the task switched in */
+static volatile uint32_t yield_start;
+static volatile bool yield_pending = false;
+static volatile uint32_t notify_start;
+static volatile bool notify_pending = false;
+
+static uint8_t filler_ids[MAX_TASKS];
+static uint8_t num_fillers = 0;
+static uint8_t waiter_id = 0xFF;
+static uint32_t bench_stack[BENCH_STACK_SIZE] __attribute__((aligned(TASK_STACK_ALIGN)));
+
+static void bench_add(bench_stat_t *stat, uint32_t cycles) {
+    stat->count++;
+    stat->sum += cycles;
+    if (cycles < stat->min) stat->min = cycles;
+    if (cycles > stat->max) stat->max = cycles;
+}
+
+static void bench_print(const char *name, const bench_stat_t *stat) {
+    printf("BENCH,%s,%u,%u,%u,%u,%u\r\n", name, num_tasks, stat->count,
+            stat->count ? stat->min : 0, stat->count ? (uint32_t)(stat->sum / stat->count) : 0, stat->max);
+}
+
+static void bench_print_latency(const char *name, uint32_t which) {
+    latency_stats_t s;
+    latency_get(which, &s);
+    printf("BENCH,%s,%u,%u,%u,%u,%u\r\n", name, num_tasks, s.count,
+            s.count ? s.min : 0, s.avg, s.max);
+}
+
+static void filler_task(void) {
+    while (1) {
+        task_yield();
+    }
+}
+
+/* Released together with the benchmark task but with a later deadline, so it runs right after its yield */
+static void partner_task(void) {
+    while (1) {
+        if (yield_pending) {
+            bench_add(&yield_stat, latency_cycles() - yield_start);
+            yield_pending = false;
+        }
+        task_yield();
+    }
+}
+
+/* Woken by the benchmark task with a deadline that preempts it */
+static void waiter_task(void) {
+    while (1) {
+        notify_wait(1);
+        if (notify_pending) {
+            bench_add(&notify_stat, latency_cycles() - notify_start);
+            notify_pending = false;
+        }
+    }
+}
+
+static int create_filler(void) {
+    uint32_t start = latency_cycles();
+    int id = create_task(filler_task, BENCH_FILLER_PERIOD, BENCH_FILLER_EXECUTION_TIME,
+                         BENCH_FILLER_PERIOD, 0, "Filler");
+    bench_add(&create_stat, latency_cycles() - start);
+    assert_param(id != 0xFF);
+    /* The report at the end holds the CPU for longer than some deadlines */
+    task_set_miss_policy((uint8_t)id, TASK_MISS_CONTINUE, NULL);
+
+    return id;
+}
+
+/* Fill the free task slots, the idle task takes the last one in start_scheduler() */
+static void bench_create(void) {
+    while (num_tasks < MAX_TASKS - 1) {
+        filler_ids[num_fillers++] = (uint8_t)create_filler();
+    }
+
+    /* Delete and create the last filler again, the slot and its stack are reused */
+    for (uint32_t i = 0; i < BENCH_ROUNDS && num_fillers > 0; i++) {
+        uint32_t start = latency_cycles();
+        bool deleted = task_delete(filler_ids[num_fillers - 1]);
+        bench_add(&delete_stat, latency_cycles() - start);
+        assert_param(deleted);
+
+        filler_ids[num_fillers - 1] = (uint8_t)create_filler();
+    }
+}
+
+/* Move each filler to the tail of the deadline queue and back, with every task queued */
+static void bench_queue(void) {
+    for (uint32_t i = 0; i < BENCH_ROUNDS && num_fillers > 0; i++) {
+        uint8_t id = filler_ids[i % num_fillers];
+        uint32_t deadline = tasks[id].deadline;
+
+        /* Keep the switch out of the measurement, it follows once interrupts are enabled */
+        __disable_irq();
+        uint32_t start = latency_cycles();
+        task_set_deadline(id, deadline + MS_TO_TICKS(1000));
+        bench_add(&queue_stat, latency_cycles() - start);
+
+        start = latency_cycles();
+        task_set_deadline(id, deadline);
+        bench_add(&queue_stat, latency_cycles() - start);
+        __enable_irq();
+    }
+}
+
+static void bench_report(void) {
+    printf("BENCH,name,tasks,samples,min,avg,max\r\n");
+    bench_print("create_task", &create_stat);
+    bench_print("task_delete", &delete_stat);
+    bench_print("deadline_queue", &queue_stat);
+    bench_print("yield", &yield_stat);
+    bench_print("notify_wake", &notify_stat);
+    bench_print_latency("context_switch", LATENCY_SWITCH);
+    bench_print_latency("tick_handler", LATENCY_TICK_HANDLER);
+    bench_print_latency("tick_entry", LATENCY_TICK_ENTRY);
+    printf("BENCH,done\r\n");
+}
+
+/* Runs the benchmarks that need the scheduler, one yield and one wake-up per job */
+static void bench_task(void) {
+    bench_queue();
+
+    /* Tick and switch histograms cover the steady state only */
+    latency_reset();
+
+    for (uint32_t i = 0; i < BENCH_ROUNDS; i++) {
+        notify_pending = true;
+        notify_start = latency_cycles();
+        notify_give(waiter_id, 1);
+
+        yield_pending = true;
+        yield_start = latency_cycles();
+        task_yield();
+    }
+
+    bench_report();
+
+    while (1) {
+        task_yield();
+    }
+}
+
+/**
+  * @brief  The benchmark entry point.
+  * @retval int
+  */
+int main(void)
+{
+    /* Disable interrupt first */
+    __disable_irq();
+
+#ifdef ENABLE_RAMFUNC
+    vector_table_to_ram();
+#endif /* ENABLE_RAMFUNC */
+
+    NVIC_SetPriority(PendSV_IRQn, 0xFF);
+
+    /* Also starts TIM2, the time base of both HAL and the scheduler */
+    HAL_Init();
+
+    /* Configure the system clock */
+    SystemClock_Config();
+
+    uart1_logger_init();
+
+    /* Starts the cycle counter, start_scheduler() takes the reference again */
+    latency_init();
+
+    printf("BENCH,start,%u,%u\r\n", SystemCoreClock, MAX_TASKS);
+
+    /* The report takes longer than a period, the late job just finishes */
+    static const task_config_t bench_config = {
+        .task_func = bench_task,
+        .name = "Bench",
+        .period = BENCH_PERIOD,
+        .execution_time = MS_TO_TICKS(1),
+        .deadline_period = BENCH_PERIOD - MS_TO_TICKS(1),
+        .miss_policy = TASK_MISS_CONTINUE,
+        .stack = bench_stack,
+        .stack_size = BENCH_STACK_SIZE,
+    };
+    uint8_t bench_id = (uint8_t)create_task_static(&bench_config);
+    assert_param(bench_id != 0xFF);
+    uint8_t partner_id = (uint8_t)create_task(partner_task, BENCH_PERIOD, US_TO_TICKS(500), BENCH_PERIOD, 0, "Partner");
+    assert_param(partner_id != 0xFF);
+    task_set_miss_policy(partner_id, TASK_MISS_CONTINUE, NULL);
+    waiter_id = (uint8_t)create_task(waiter_task, BENCH_PERIOD, US_TO_TICKS(50), MS_TO_TICKS(1), 0, "Waiter");
+    assert_param(waiter_id != 0xFF);
+    task_set_miss_policy(waiter_id, TASK_MISS_CONTINUE, NULL);
+
+    bench_create();
+
+    /* Start the scheduler */
+    start_scheduler();
+    /* Should not get here! */
+    assert_param(false);
+}
@@ -0,0 +1,79 @@
+#include "main.h"
+#include <stdio.h>
+
+/* Board setup shared by the demo application (main.c) and the benchmark firmware (bench_main.c) */
+
+/**
+  * @brief System Clock Configuration
+  * @retval None
+  */
+void SystemClock_Config(void)
+{
+    RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+    RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
+
+    /** Configure the main internal regulator output voltage */
+    __HAL_RCC_PWR_CLK_ENABLE();
+    __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE1);
+    /** Initializes the RCC Oscillators according to the specified parameters in the RCC_OscInitTypeDef structure. */
+    RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSE;
+    RCC_OscInitStruct.HSEState = RCC_HSE_ON;
+    RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+    RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
+    RCC_OscInitStruct.PLL.PLLM = 8;
+    RCC_OscInitStruct.PLL.PLLN = 336;
+    RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV2;
+    RCC_OscInitStruct.PLL.PLLQ = 7;
+    if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK) {
+        assert_param(false);
+    }
+    /** Initializes the CPU, AHB and APB buses clocks */
+    RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
+        |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
+    RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+    RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
+    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV4;
+    RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV2;
+
+    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_5) != HAL_OK) {
+        assert_param(false);
+    }
+}
+
+#ifdef  USE_FULL_ASSERT
+/**
+  * @brief  Reports the name of the source file and the source line number
+  *         where the assert_param error has occurred.
+  * @param  file: pointer to the source file name
+  * @param  line: assert_param error line source number
+  * @retval None
+  */
+void assert_failed(uint8_t *file, uint32_t line) {
+    __disable_irq();
+    printf("assert failed: at %s, line %u\r\n", file, line);
+    while(1);
+}
+#endif /* USE_FULL_ASSERT */
+
+#ifdef ENABLE_RAMFUNC
+/* Vectors of the core exceptions and of all F407 interrupts */
+#define VECTOR_TABLE_SIZE (16 + FPU_IRQn + 1)
+
+/* VTOR needs the table aligned to its size rounded up to a power of two */
+static uint32_t ram_vector_table[VECTOR_TABLE_SIZE] __attribute__((section(".ram_vector"), aligned(512)));
+
+_Static_assert(sizeof(ram_vector_table) <= 512, "ram_vector_table alignment too small");
+
+/* Run the exception handlers through a copy of the vector table in SRAM, call with interrupts disabled */
+void vector_table_to_ram(void) {
+    const uint32_t *flash_vectors = (const uint32_t *)SCB->VTOR;
+
+    for (uint32_t i = 0; i < VECTOR_TABLE_SIZE; i++) {
+        ram_vector_table[i] = flash_vectors[i];
+    }
+    __DSB();
+    SCB->VTOR = (uint32_t)ram_vector_table;
+    __DSB();
+    __ISB();
+}
+#endif /* ENABLE_RAMFUNC */
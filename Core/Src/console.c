@@ -0,0 +1,216 @@
+#include "main.h"
+#include "console.h"
+#include "uart1_logger.h"
+#include "notify.h"
+#include "cpu_load.h"
+#include "trace.h"
+#include "log.h"
+#include "latency.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Notification bit set by the receive interrupt at the end of a line */
+#define CONSOLE_NOTIFY_LINE (1UL << 0)
+
+static volatile uint8_t rx_buffer[CONSOLE_RX_SIZE];
+static volatile uint32_t rx_head = 0;    /* Written by the interrupt */
+static volatile uint32_t rx_tail = 0;    /* Read by the console task */
+
+static uint8_t console_id = 0xFF;
+static uint32_t console_stack[CONSOLE_STACK_SIZE] __attribute__((aligned(TASK_STACK_ALIGN)));
+
+/* Called from the USART1 interrupt for every received byte */
+static void console_rx(uint8_t byte) {
+    if (rx_head - rx_tail < CONSOLE_RX_SIZE) {
+        rx_buffer[rx_head & (CONSOLE_RX_SIZE - 1)] = byte;
+        rx_head++;
+    }
+    if (byte == '\r' || byte == '\n') {
+        notify_give(console_id, CONSOLE_NOTIFY_LINE);
+    }
+}
+
+static void cmd_help(void) {
+    printf("commands: ps, stats, trace dump, "
+#ifdef ENABLE_LATENCY_STATS
+            "latency [reset], "
+#endif /* ENABLE_LATENCY_STATS */
+            "set loglevel none|error|warn|info|debug|trace, help\r\n");
+}
+
+static void cmd_ps(void) {
+    uint32_t now = get_tick();
+
+    printf("ID NAME             STATE     PERIOD     DEADLINE IN LOAD    MISSES\r\n");
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        if (tasks[i].state == TASK_FREE) {
+            continue;
+        }
+        uint16_t load = cpu_load_get_task(CPU_LOAD_LONG, i);
+        printf("%2u %-16s %-9s ", i, tasks[i].name, task_get_state_str(i));
+        if (tasks[i].period == TASK_NO_DEADLINE) {
+            printf("%10s %11s ", "-", "-");
+        }
+        else {
+            printf("%10u %11d ", tasks[i].period, (int)(tasks[i].deadline - now));
+        }
+        printf("%3u.%u%% %6u\r\n", load / 10, load % 10, task_get_miss_count(i));
+    }
+}
+
+static void cmd_stats(void) {
+    uint32_t misses = 0;
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        misses += task_get_miss_count(i);
+    }
+    uint16_t load_short = cpu_load_get_total(CPU_LOAD_SHORT);
+    uint16_t load_long = cpu_load_get_total(CPU_LOAD_LONG);
+
+    printf("uptime %u ticks, %u tasks, criticality mode %s, log level %s\r\n",
+            get_tick(), num_tasks, task_get_criticality_mode() == TASK_CRIT_HI ? "HI" : "LO",
+            log_level_str(log_get_level()));
+    printf("CPU load %u.%u%% over %u ticks, %u.%u%% over %u ticks, %u deadline misses\r\n",
+            load_short / 10, load_short % 10, CPU_LOAD_SHORT_WINDOW,
+            load_long / 10, load_long % 10, CPU_LOAD_LONG_WINDOW, misses);
+}
+
+static void cmd_trace_dump(void) {
+    trace_event_t events[TRACE_SIZE];
+    uint32_t n = trace_snapshot(events, TRACE_SIZE);
+
+    for (uint32_t i = 0; i < n; i++) {
+        printf("%10u %-8s task %u arg %u\r\n",
+                events[i].time, trace_type_str(events[i].type), events[i].task_id, events[i].arg);
+    }
+#ifdef ENABLE_TRACE_STREAM
+    printf("%u events dropped from the trace stream\r\n", trace_stream_dropped());
+#endif /* ENABLE_TRACE_STREAM */
+}
+
+#ifdef ENABLE_LATENCY_STATS
+static void cmd_latency(void) {
+    latency_report();
+}
+
+static void cmd_latency_reset(void) {
+    latency_reset();
+    printf("latency histograms cleared\r\n");
+}
+#endif /* ENABLE_LATENCY_STATS */
+
+static void cmd_set_loglevel(const char *arg) {
+    char *end;
+    unsigned long level = strtoul(arg, &end, 10);
+
+    if (end == arg || *end != '\0') {
+        /* Not a number, look the name up */
+        for (level = LOG_LEVEL_NONE; level <= LOG_LEVEL_TRACE; level++) {
+            if (strcmp(arg, log_level_str(level)) == 0) {
+                break;
+            }
+        }
+    }
+    if (level > LOG_LEVEL_TRACE) {
+        printf("unknown log level '%s'\r\n", arg);
+        return;
+    }
+    log_set_level((uint8_t)level);
+    printf("log level %s\r\n", log_level_str(log_get_level()));
+}
+
+static void console_execute(char *line) {
+    if (strcmp(line, "ps") == 0) {
+        cmd_ps();
+    }
+    else if (strcmp(line, "stats") == 0) {
+        cmd_stats();
+    }
+    else if (strcmp(line, "trace dump") == 0) {
+        cmd_trace_dump();
+    }
+#ifdef ENABLE_LATENCY_STATS
+    else if (strcmp(line, "latency") == 0) {
+        cmd_latency();
+    }
+    else if (strcmp(line, "latency reset") == 0) {
+        cmd_latency_reset();
+    }
+#endif /* ENABLE_LATENCY_STATS */
+    else if (strncmp(line, "set loglevel ", 13) == 0) {
+        cmd_set_loglevel(line + 13);
+    }
+    else if (strcmp(line, "help") == 0) {
+        cmd_help();
+    }
+    else {
+        printf("unknown command '%s', try help\r\n", line);
+    }
+}
+
+/* Console task, one job per received line */
+/* Jobs are at least CONSOLE_PERIOD apart, a burst of lines is worked off one line per period */
+static void console_task_func(void) {
+    char line[CONSOLE_LINE_SIZE];
+    uint32_t len = 0;
+    bool overflow = false;
+
+    while (1) {
+        if (rx_tail == rx_head) {
+            notify_wait(CONSOLE_NOTIFY_LINE);
+        }
+
+        bool executed = false;
+        while (!executed && rx_tail != rx_head) {
+            char c = (char)rx_buffer[rx_tail & (CONSOLE_RX_SIZE - 1)];
+            rx_tail++;
+
+            if (c == '\r' || c == '\n') {
+                line[len] = '\0';
+                if (overflow) {
+                    printf("line too long\r\n");
+                }
+                else if (len > 0) {
+                    console_execute(line);
+                }
+                executed = overflow || len > 0;
+                len = 0;
+                overflow = false;
+            }
+            else if (c == '\b' || c == 0x7F) {
+                if (len > 0) {
+                    len--;
+                }
+            }
+            else if (len < CONSOLE_LINE_SIZE - 1) {
+                line[len++] = c;
+            }
+            else {
+                overflow = true;
+            }
+        }
+
+        /* The next job is released one period after this one at the earliest */
+        task_yield();
+    }
+}
+
+/* Create the console task and start reception, call before start_scheduler() */
+void console_init(void) {
+    task_config_t config = {
+        .task_func = console_task_func,
+        .name = "Console",
+        .period = CONSOLE_PERIOD,
+        .execution_time = CONSOLE_EXECUTION_TIME,
+        .deadline_period = CONSOLE_PERIOD,
+        /* A long reply may overrun the budget, it is finished anyway */
+        .miss_policy = TASK_MISS_CONTINUE,
+        .stack = console_stack,
+        .stack_size = CONSOLE_STACK_SIZE,
+    };
+
+    console_id = create_task_static(&config);
+    assert_param(console_id != 0xFF);
+
+    uart1_logger_set_rx_callback(console_rx);
+}
@@ -0,0 +1,121 @@
+#include "main.h"
+#include "cpu_load.h"
+#include "ramfunc.h"
+#include "tbs.h"
+#include <stdio.h>
+
+#ifndef LOG_LEVEL_CPU_LOAD
+#define LOG_LEVEL_CPU_LOAD LOG_LEVEL
+#endif
+#define LOG_MODULE_LEVEL LOG_LEVEL_CPU_LOAD
+#include "log.h"
+
+/* Task run time accounting over fixed windows */
+typedef struct {
+    uint32_t length;                  /* Window length in ticks */
+    uint32_t start;                   /* Start of the window being measured */
+    uint32_t run_time_at_start[MAX_TASKS];
+    uint16_t load[MAX_TASKS];         /* Load of each task in the last completed window */
+} cpu_load_window_t;
+
+static cpu_load_window_t windows[CPU_LOAD_NUM_WINDOWS] = {
+    [CPU_LOAD_SHORT] = { .length = CPU_LOAD_SHORT_WINDOW },
+    [CPU_LOAD_LONG] = { .length = CPU_LOAD_LONG_WINDOW },
+};
+
+static volatile bool report_pending = false;
+
+#if defined(ENABLE_CPU_LOAD_REPORT) && defined(ENABLE_TBS)
+/* Budget of one report, printing over the 115200 baud logger is slow */
+#define CPU_LOAD_REPORT_TICKS MS_TO_TICKS(50)
+
+static void cpu_load_report_job(void *arg) {
+    cpu_load_report();
+}
+#endif
+
+/* Close every window that ended by now, called from the tick handler */
+RAMFUNC void cpu_load_update(uint32_t now) {
+    for (uint8_t w = 0; w < CPU_LOAD_NUM_WINDOWS; w++) {
+        cpu_load_window_t *window = &windows[w];
+
+        if (!time_after_eq(now, window->start + window->length)) {
+            continue;
+        }
+
+        /* Normalize by the actual elapsed time, the tick may come late */
+        uint32_t elapsed = now - window->start;
+        for (uint8_t i = 0; i < num_tasks; i++) {
+            uint32_t run_time = task_get_run_time(i);
+            window->load[i] = (uint16_t)((uint64_t)(run_time - window->run_time_at_start[i]) * CPU_LOAD_SCALE / elapsed);
+            window->run_time_at_start[i] = run_time;
+        }
+        window->start = now;
+
+        if (w == CPU_LOAD_LONG) {
+#if defined(ENABLE_CPU_LOAD_REPORT) && defined(ENABLE_TBS)
+            /* Served as an aperiodic job instead of waiting for idle time */
+            if (!tbs_submit(cpu_load_report_job, NULL, CPU_LOAD_REPORT_TICKS)) {
+                report_pending = true;
+            }
+#else
+            report_pending = true;
+#endif
+        }
+    }
+}
+
+/* End of the window that closes first, the tick handler wakes up for it */
+RAMFUNC uint32_t cpu_load_next_update(void) {
+    uint32_t next = windows[0].start + windows[0].length;
+    for (uint8_t w = 1; w < CPU_LOAD_NUM_WINDOWS; w++) {
+        if (time_before(windows[w].start + windows[w].length, next)) {
+            next = windows[w].start + windows[w].length;
+        }
+    }
+    return next;
+}
+
+/* Measured load of a task in the last completed window */
+uint16_t cpu_load_get_task(uint8_t window, uint8_t task_id) {
+    return windows[window].load[task_id];
+}
+
+/* Declared utilization of a task, execution_time / period */
+uint16_t cpu_load_get_declared(uint8_t task_id) {
+    if (tasks[task_id].period == TASK_NO_DEADLINE || tasks[task_id].period == 0) {
+        return 0;
+    }
+    return (uint16_t)((uint64_t)tasks[task_id].execution_time * CPU_LOAD_SCALE / tasks[task_id].period);
+}
+
+/* Load of all tasks except idle in the last completed window */
+uint16_t cpu_load_get_total(uint8_t window) {
+    uint16_t idle_load = windows[window].load[get_idle_task_id()];
+    return (idle_load < CPU_LOAD_SCALE) ? CPU_LOAD_SCALE - idle_load : 0;
+}
+
+/* True once per long window, when a new report is available */
+bool cpu_load_report_pending(void) {
+    return report_pending;
+}
+
+/* Print measured against declared utilization of the last long window */
+void cpu_load_report(void) {
+    report_pending = false;
+
+    uint16_t total = cpu_load_get_total(CPU_LOAD_LONG);
+    LOG_INFO("\r\n##### CPU load over %u ticks: %u.%u%% (last %u ticks: %u.%u%%) #####\r\n",
+            CPU_LOAD_LONG_WINDOW, total / 10, total % 10,
+            CPU_LOAD_SHORT_WINDOW, cpu_load_get_total(CPU_LOAD_SHORT) / 10, cpu_load_get_total(CPU_LOAD_SHORT) % 10);
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        if (tasks[i].state == TASK_FREE) {
+            continue;
+        }
+        uint16_t measured = cpu_load_get_task(CPU_LOAD_LONG, i);
+        uint16_t declared = cpu_load_get_declared(i);
+        LOG_INFO("\t- %s: measured %u.%u%%, declared %u.%u%%, %u deadline misses\r\n",
+                tasks[i].name, measured / 10, measured % 10, declared / 10, declared % 10,
+                task_get_miss_count(i));
+    }
+}
@@ -0,0 +1,32 @@
+#include "main.h"
+#include "dlog.h"
+#include "uart1_logger.h"
+#include <stdarg.h>
+
+/* Send one frame, every argument is read as a 32-bit word */
+void dlog_write(uint32_t id, uint32_t nargs, ...) {
+    uint8_t frame[4 + 4 * DLOG_MAX_ARGS];
+    uint32_t len = 0;
+
+    if (nargs > DLOG_MAX_ARGS) {
+        nargs = DLOG_MAX_ARGS;
+    }
+
+    frame[len++] = DLOG_SYNC;
+    frame[len++] = (uint8_t)id;
+    frame[len++] = (uint8_t)(id >> 8);
+    frame[len++] = (uint8_t)nargs;
+
+    va_list args;
+    va_start(args, nargs);
+    for (uint32_t i = 0; i < nargs; i++) {
+        uint32_t value = va_arg(args, uint32_t);
+        frame[len++] = (uint8_t)value;
+        frame[len++] = (uint8_t)(value >> 8);
+        frame[len++] = (uint8_t)(value >> 16);
+        frame[len++] = (uint8_t)(value >> 24);
+    }
+    va_end(args);
+
+    uart1_logger_write(frame, len);
+}
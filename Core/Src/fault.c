@@ -0,0 +1,130 @@
+#include "main.h"
+#include "task.h"
+#include "trace.h"
+#include "fault.h"
+#include "stack_guard.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Marks a valid record, anything else is left over from power-up */
+#define FAULT_RECORD_MAGIC 0xFA017EC0
+
+#define FAULT_NAME_LEN 16
+
+typedef struct {
+    uint32_t magic;
+    uint32_t exception;         /* IPSR of the handler: 3 HardFault, 4 MemManage, 5 BusFault, 6 UsageFault */
+    uint32_t frame_valid;       /* 0 if stacking the frame failed, frame is zero then */
+    uint32_t frame[8];          /* Stacked R0-R3, R12, LR, PC, xPSR */
+    uint32_t exc_return;
+    uint32_t cfsr;
+    uint32_t hfsr;
+    uint32_t mmfar;
+    uint32_t bfar;
+    uint32_t time;              /* System ticks at the fault */
+    uint8_t task_id;
+    char task_name[FAULT_NAME_LEN];
+    uint32_t num_events;
+    trace_event_t events[TRACE_SIZE];
+    uint32_t checksum;          /* Sum of the words above */
+} fault_record_t;
+
+/* Not cleared by the startup code, survives a reset */
+static fault_record_t fault_record __attribute__((section(".noinit")));
+
+static uint32_t fault_record_sum(void) {
+    const uint32_t *words = (const uint32_t *)&fault_record;
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < offsetof(fault_record_t, checksum) / sizeof(uint32_t); i++) {
+        sum += words[i];
+    }
+    return sum;
+}
+
+/* Called by fault_entry with the frame pushed on exception entry */
+void __attribute__((noreturn, used)) fault_capture(uint32_t *frame, uint32_t exc_return) {
+#ifdef ENABLE_STACK_GUARD
+    /* An overflow pushes the frame into the guard, reading it must not fault again */
+    MPU->CTRL = 0;
+    __DSB();
+    __ISB();
+#endif /* ENABLE_STACK_GUARD */
+
+    fault_record.exception = __get_IPSR();
+    /* The frame was not (completely) written if stacking faulted */
+    fault_record.frame_valid = (SCB->CFSR & (SCB_CFSR_MSTKERR_Msk | SCB_CFSR_STKERR_Msk)) == 0;
+    for (uint32_t i = 0; i < 8; i++) {
+        fault_record.frame[i] = fault_record.frame_valid ? frame[i] : 0;
+    }
+    fault_record.exc_return = exc_return;
+    fault_record.cfsr = SCB->CFSR;
+    fault_record.hfsr = SCB->HFSR;
+    fault_record.mmfar = SCB->MMFAR;
+    fault_record.bfar = SCB->BFAR;
+    fault_record.time = get_tick();
+
+    uint8_t task_id = task_get_current_id();
+    fault_record.task_id = task_id;
+    memset(fault_record.task_name, 0, FAULT_NAME_LEN);
+    if (task_id < num_tasks && tasks[task_id].name != NULL) {
+        strncpy(fault_record.task_name, tasks[task_id].name, FAULT_NAME_LEN - 1);
+    }
+
+    fault_record.num_events = trace_snapshot(fault_record.events, TRACE_SIZE);
+    fault_record.magic = FAULT_RECORD_MAGIC;
+    fault_record.checksum = fault_record_sum();
+
+#ifdef ENABLE_STACK_GUARD
+    stack_guard_report_fault();
+#endif /* ENABLE_STACK_GUARD */
+
+#ifdef FAULT_HALT_ON_FAULT
+    while (1);
+#else
+    NVIC_SystemReset();
+#endif
+}
+
+/* Common entry of the fault handlers, finds the stack the frame was pushed on */
+void __attribute__((naked)) fault_entry(void) {
+    __asm volatile (
+        "TST LR, #4\n"            /* EXC_RETURN bit 2: 0 = MSP, 1 = PSP */
+        "ITE EQ\n"
+        "MRSEQ R0, MSP\n"
+        "MRSNE R0, PSP\n"
+        "MOV R1, LR\n"
+        "B fault_capture\n"
+    );
+}
+
+/* Print and clear the record of a fault before the last reset, call once the logger is up */
+void fault_report_last(void) {
+    if (fault_record.magic != FAULT_RECORD_MAGIC || fault_record.checksum != fault_record_sum()) {
+        return;
+    }
+
+    printf("\r\n!!!!!!!!!!!!!!!!!!!!!! Fault before last reset !!!!!!!!!!!!!!!!!!!!!!\r\n");
+    printf("\t- exception %u at ticks %u in task %s (%u)\r\n",
+            fault_record.exception, fault_record.time, fault_record.task_name, fault_record.task_id);
+    if (fault_record.frame_valid) {
+        printf("\t- PC 0x%08x, LR 0x%08x, xPSR 0x%08x, EXC_RETURN 0x%08x\r\n",
+                fault_record.frame[6], fault_record.frame[5], fault_record.frame[7], fault_record.exc_return);
+        printf("\t- R0 0x%08x, R1 0x%08x, R2 0x%08x, R3 0x%08x, R12 0x%08x\r\n",
+                fault_record.frame[0], fault_record.frame[1], fault_record.frame[2], fault_record.frame[3],
+                fault_record.frame[4]);
+    }
+    else {
+        printf("\t- exception frame not stacked (stack overflow), EXC_RETURN 0x%08x\r\n",
+                fault_record.exc_return);
+    }
+    printf("\t- CFSR 0x%08x, HFSR 0x%08x, MMFAR 0x%08x, BFAR 0x%08x\r\n",
+            fault_record.cfsr, fault_record.hfsr, fault_record.mmfar, fault_record.bfar);
+    printf("\t- last %u scheduler events:\r\n", fault_record.num_events);
+    for (uint32_t i = 0; i < fault_record.num_events && i < TRACE_SIZE; i++) {
+        trace_event_t *event = &fault_record.events[i];
+        printf("\t\t%u %s task %u arg %u\r\n", event->time, trace_type_str(event->type), event->task_id, event->arg);
+    }
+
+    fault_record.magic = 0;
+}
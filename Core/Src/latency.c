@@ -0,0 +1,185 @@
+#include "main.h"
+#include "latency.h"
+#include "timer2_tick.h"
+#include <stdio.h>
+
+/* Longest plausible tick entry latency in TIM2 ticks, longer samples mean the reference is stale */
+#define LATENCY_ENTRY_MAX_TICKS 100
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t buckets[LATENCY_BUCKETS + 1];  /* Last one is the overflow bucket */
+} latency_hist_t;
+
+static latency_hist_t hist[LATENCY_NUM];
+static uint32_t dropped = 0;
+
+/* Reference point, the cycle count at which the TIM2 counter changed to ref_cnt */
+static uint32_t ref_cycles;
+static uint32_t ref_cnt;
+static uint32_t cycles_per_tick;
+
+static uint32_t tick_enter_cycles;
+static uint32_t switch_request_cycles;
+static bool switch_requested = false;
+
+static const char *const latency_names[LATENCY_NUM] = {
+    "tick entry", "tick handler", "switch"
+};
+
+/* Pair a TIM2 counter edge with a cycle count, takes up to one TIM2 tick */
+static void latency_sync(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    cycles_per_tick = SystemCoreClock / TIMER2_COUNTER_HZ;
+    uint32_t cnt = timer2_get_counter();
+    while (timer2_get_counter() == cnt);
+    ref_cycles = latency_cycles();
+    ref_cnt = cnt + 1;
+
+    __set_PRIMASK(primask);
+}
+
+/* Start the cycle counter, call before the tick callback is set */
+void latency_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    latency_reset();
+    latency_sync();
+}
+
+void latency_reset(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    for (uint32_t i = 0; i < LATENCY_NUM; i++) {
+        hist[i] = (latency_hist_t){ .min = UINT32_MAX };
+    }
+    dropped = 0;
+
+    __set_PRIMASK(primask);
+}
+
+void latency_add(uint32_t which, uint32_t cycles) {
+    assert_param(which < LATENCY_NUM);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    latency_hist_t *h = &hist[which];
+    uint32_t bucket = cycles >> LATENCY_BUCKET_SHIFT;
+    h->buckets[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS]++;
+    h->count++;
+    h->sum += cycles;
+    if (cycles < h->min) h->min = cycles;
+    if (cycles > h->max) h->max = cycles;
+
+    __set_PRIMASK(primask);
+}
+
+/* Summary of one histogram, returns false if it has no samples yet */
+bool latency_get(uint32_t which, latency_stats_t *stats) {
+    assert_param(which < LATENCY_NUM);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    const latency_hist_t *h = &hist[which];
+    *stats = (latency_stats_t){ .count = h->count, .min = h->min, .max = h->max,
+                                .overflow = h->buckets[LATENCY_BUCKETS] };
+    if (h->count > 0) {
+        stats->avg = (uint32_t)(h->sum / h->count);
+
+        /* Walk up to the bucket that holds 99% of the samples */
+        uint32_t target = h->count - h->count / 100;
+        uint32_t seen = 0;
+        uint32_t bucket = 0;
+        while (bucket < LATENCY_BUCKETS && (seen += h->buckets[bucket]) < target) {
+            bucket++;
+        }
+        stats->p99 = bucket < LATENCY_BUCKETS ? (bucket + 1) << LATENCY_BUCKET_SHIFT : h->max;
+        if (stats->p99 > h->max) stats->p99 = h->max;
+    }
+
+    __set_PRIMASK(primask);
+
+    return h->count > 0;
+}
+
+const char *latency_name(uint32_t which) {
+    return which < LATENCY_NUM ? latency_names[which] : "?";
+}
+
+/* Print all histograms, in cycles and nanoseconds */
+void latency_report(void) {
+    uint32_t cycles_per_us = SystemCoreClock / 1000000;
+
+    for (uint32_t i = 0; i < LATENCY_NUM; i++) {
+        latency_stats_t s;
+        if (!latency_get(i, &s)) {
+            printf("%-12s no samples\r\n", latency_name(i));
+            continue;
+        }
+        printf("%-12s n %u min %u avg %u max %u p99 %u cycles (%u/%u/%u/%u ns), %u over %u\r\n",
+                latency_name(i), s.count, s.min, s.avg, s.max, s.p99,
+                s.min * 1000 / cycles_per_us, s.avg * 1000 / cycles_per_us,
+                s.max * 1000 / cycles_per_us, s.p99 * 1000 / cycles_per_us,
+                s.overflow, LATENCY_BUCKETS << LATENCY_BUCKET_SHIFT);
+    }
+    printf("%u tick entry samples dropped\r\n", dropped);
+}
+
+/* Start of the scheduler tick handler, the pending compare value is the event that raised it */
+void latency_tick_enter(void) {
+    tick_enter_cycles = latency_cycles();
+
+    if (cycles_per_tick != SystemCoreClock / TIMER2_COUNTER_HZ) {
+        /* Clock changed, the reference is meaningless */
+        dropped++;
+        latency_sync();
+        tick_enter_cycles = latency_cycles();
+        return;
+    }
+
+    uint32_t event_cycles = ref_cycles + (timer2_get_next_event() - ref_cnt) * cycles_per_tick;
+    int32_t latency = (int32_t)(tick_enter_cycles - event_cycles);
+    if (latency < 0 || (uint32_t)latency > LATENCY_ENTRY_MAX_TICKS * cycles_per_tick) {
+        /* Counter moved by STOP mode or stopped under a debugger */
+        dropped++;
+        latency_sync();
+        tick_enter_cycles = latency_cycles();
+        return;
+    }
+    latency_add(LATENCY_TICK_ENTRY, (uint32_t)latency);
+}
+
+void latency_tick_exit(void) {
+    latency_add(LATENCY_TICK_HANDLER, latency_cycles() - tick_enter_cycles);
+}
+
+/* PendSV is being pended, only the first request counts until the switch happens */
+void latency_switch_requested(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (!switch_requested) {
+        switch_request_cycles = latency_cycles();
+        switch_requested = true;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/* End of PendSV, called with interrupts disabled */
+void latency_switch_done(void) {
+    if (switch_requested) {
+        switch_requested = false;
+        latency_add(LATENCY_SWITCH, latency_cycles() - switch_request_cycles);
+    }
+}
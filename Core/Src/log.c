@@ -0,0 +1,32 @@
+#include "main.h"
+#include "log.h"
+
+/* Starts open, the compile-time thresholds of the modules are the default filter */
+volatile uint8_t log_level = LOG_LEVEL_TRACE;
+
+void log_set_level(uint8_t level) {
+    if (level > LOG_LEVEL_TRACE) {
+        level = LOG_LEVEL_TRACE;
+    }
+    log_level = level;
+}
+
+uint8_t log_get_level(void) {
+    return log_level;
+}
+
+const char *log_level_str(uint8_t level) {
+    static const char *const names[] = {
+        [LOG_LEVEL_NONE] = "none",
+        [LOG_LEVEL_ERROR] = "error",
+        [LOG_LEVEL_WARN] = "warn",
+        [LOG_LEVEL_INFO] = "info",
+        [LOG_LEVEL_DEBUG] = "debug",
+        [LOG_LEVEL_TRACE] = "trace",
+    };
+
+    if (level > LOG_LEVEL_TRACE) {
+        return "unknown";
+    }
+    return names[level];
+}
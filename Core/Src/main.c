@@ -20,28 +20,44 @@
 #include "main.h"
 #include "uart1_logger.h"
 #include "timer2_tick.h"
+#include "workload.h"
+#include "power.h"
+#include "tbs.h"
+#include "fault.h"
+#include "console.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdbool.h>
 
+#ifndef LOG_LEVEL_APP
+#define LOG_LEVEL_APP LOG_LEVEL
+#endif
+#define LOG_MODULE_LEVEL LOG_LEVEL_APP
+#include "log.h"
+
+/* The scenario can also be picked from the command line, e.g. make SCENARIO=RUN_NORMAL_SCHELUDABLE_EDF */
+#if !defined(RUN_NORMAL_SCHELUDABLE_EDF) && !defined(RUN_CONCURRENT_SCHELUDABLE_EDF) \
+    && !defined(RUN_UNSCHELUDABLE_TASKSET_EDF) && !defined(RUN_MIXED_CRITICALITY_EDF)
 // #define RUN_NORMAL_SCHELUDABLE_EDF
 // #define RUN_CONCURRENT_SCHELUDABLE_EDF
 #define RUN_UNSCHELUDABLE_TASKSET_EDF
-
-#if defined(RUN_NORMAL_SCHELUDABLE_EDF) + defined(RUN_CONCURRENT_SCHELUDABLE_EDF) + defined(RUN_UNSCHELUDABLE_TASKSET_EDF) != 1
-#error Define exactly one of RUN_NORMAL_SCHELUDABLE_EDF, RUN_CONCURRENT_SCHELUDABLE_EDF, RUN_UNSCHELUDABLE_TASKSET_EDF
+// #define RUN_MIXED_CRITICALITY_EDF
 #endif
 
-void SystemClock_Config(void);
+#if defined(RUN_NORMAL_SCHELUDABLE_EDF) + defined(RUN_CONCURRENT_SCHELUDABLE_EDF) + defined(RUN_UNSCHELUDABLE_TASKSET_EDF) \
+    + defined(RUN_MIXED_CRITICALITY_EDF) != 1
+#error Define exactly one of RUN_NORMAL_SCHELUDABLE_EDF, RUN_CONCURRENT_SCHELUDABLE_EDF, RUN_UNSCHELUDABLE_TASKSET_EDF, RUN_MIXED_CRITICALITY_EDF
+#endif
 
 #ifdef RUN_NORMAL_SCHELUDABLE_EDF
 /* Example task 1 */
 static void task1(void) {
     while(1) {
         /* Task 1 code */
-        printf("\r\n+++++++++++++++++++++++ Task1 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
-        /* Simulate work with delay */
-        HAL_Delay(9);
-        printf("\r\n++++++++++++++++++++++ Task1 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
+        LOG_INFO("\r\n+++++++++++++++++++++++ Task1 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
+        /* Simulate work by burning CPU time */
+        workload_burn_us(9000);
+        LOG_INFO("\r\n++++++++++++++++++++++ Task1 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
         /* Yield as task is finished for current period */
         task_yield();
     }
@@ -51,10 +67,10 @@ static void task1(void) {
 static void task2(void) {
     while(1) {
         /* Task 2 code */
-        printf("\r\n+++++++++++++++++++++++ Task2 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
-        /* Simulate work with delay */
-        HAL_Delay(4);
-        printf("\r\n++++++++++++++++++++++ Task2 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
+        LOG_INFO("\r\n+++++++++++++++++++++++ Task2 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
+        /* Simulate work by burning CPU time */
+        workload_burn_us(4000);
+        LOG_INFO("\r\n++++++++++++++++++++++ Task2 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
         /* Yield as task is finished for current period */
         task_yield();
     }
@@ -64,14 +80,25 @@ static void task2(void) {
 static void task3(void) {
     while(1) {
         /* Task 3 code */
-        printf("\r\n+++++++++++++++++++++++ Task3 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
-        /* Simulate work with delay */
-        HAL_Delay(4);
-        printf("\r\n++++++++++++++++++++++ Task3 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
+        LOG_INFO("\r\n+++++++++++++++++++++++ Task3 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
+        /* Simulate work by burning CPU time */
+        workload_burn_us(4000);
+        LOG_INFO("\r\n++++++++++++++++++++++ Task3 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
         /* Yield as task is finished for current period */
         task_yield();
     }
 }
+
+/* Task set: period, ~execution time, relative deadline and release offset in milliseconds */
+/* Offsets from Tools/edf_offsets.py Task1:40:10 Task2:40:5:30 Task3:30:5:15 */
+#define EDF_TASK_TABLE(X) \
+    X(task1, "Task1", MS_TO_TICKS(40), MS_TO_TICKS(10), MS_TO_TICKS(40), 0, 512) \
+    X(task2, "Task2", MS_TO_TICKS(40), MS_TO_TICKS(5), MS_TO_TICKS(30), MS_TO_TICKS(8), 512) \
+    X(task3, "Task3", MS_TO_TICKS(30), MS_TO_TICKS(5), MS_TO_TICKS(15), MS_TO_TICKS(7), 512)
+/* Task1 defers preemptions by up to 5 ms, Task3 (D = 15 ms) still fits */
+#define EDF_TASK_TABLE_NPR(X) \
+    X(task1, MS_TO_TICKS(5))
+#define EDF_TASK_TABLE_HYPERPERIOD MS_TO_TICKS(120)
 #endif  /* RUN_NORMAL_SCHELUDABLE_EDF */
 
 #ifdef RUN_CONCURRENT_SCHELUDABLE_EDF
@@ -79,10 +106,10 @@ static void task3(void) {
 static void task1(void) {
     while(1) {
         /* Task 1 code */
-        printf("\r\n+++++++++++++++++++++++ Task1 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
-        /* Simulate work with delay */
-        HAL_Delay(9);
-        printf("\r\n++++++++++++++++++++++ Task1 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
+        LOG_INFO("\r\n+++++++++++++++++++++++ Task1 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
+        /* Simulate work by burning CPU time */
+        workload_burn_us(9000);
+        LOG_INFO("\r\n++++++++++++++++++++++ Task1 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
         /* Yield as task is finished for current period */
         task_yield();
     }
@@ -92,10 +119,10 @@ static void task1(void) {
 static void task2(void) {
     while(1) {
         /* Task 2 code */
-        printf("\r\n+++++++++++++++++++++++ Task2 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
-        /* Simulate work with delay */
-        HAL_Delay(9);
-        printf("\r\n++++++++++++++++++++++ Task2 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
+        LOG_INFO("\r\n+++++++++++++++++++++++ Task2 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
+        /* Simulate work by burning CPU time */
+        workload_burn_us(9000);
+        LOG_INFO("\r\n++++++++++++++++++++++ Task2 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
         /* Yield as task is finished for current period */
         task_yield();
     }
@@ -105,14 +132,26 @@ static void task2(void) {
 static void task3(void) {
     while(1) {
         /* Task 3 code */
-        printf("\r\n+++++++++++++++++++++++ Task3 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
-        /* Simulate work with delay */
-        HAL_Delay(9);
-        printf("\r\n++++++++++++++++++++++ Task3 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
+        LOG_INFO("\r\n+++++++++++++++++++++++ Task3 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
+        /* Simulate work by burning CPU time */
+        workload_burn_us(9000);
+        LOG_INFO("\r\n++++++++++++++++++++++ Task3 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
         /* Yield as task is finished for current period */
         task_yield();
     }
 }
+
+/* Task set: period, ~execution time, relative deadline and release offset in milliseconds */
+#define EDF_TASK_TABLE(X) \
+    X(task1, "Task1", MS_TO_TICKS(40), MS_TO_TICKS(10), MS_TO_TICKS(40), 0, 512) \
+    X(task2, "Task2", MS_TO_TICKS(40), MS_TO_TICKS(10), MS_TO_TICKS(40), 0, 512) \
+    X(task3, "Task3", MS_TO_TICKS(40), MS_TO_TICKS(10), MS_TO_TICKS(40), 0, 512)
+/* Equal deadlines, so each job can run to completion in one piece */
+#define EDF_TASK_TABLE_NPR(X) \
+    X(task1, MS_TO_TICKS(10)) \
+    X(task2, MS_TO_TICKS(10)) \
+    X(task3, MS_TO_TICKS(10))
+#define EDF_TASK_TABLE_HYPERPERIOD MS_TO_TICKS(40)
 #endif  /* RUN_CONCURRENT_SCHELUDABLE_EDF */
 
 #ifdef RUN_UNSCHELUDABLE_TASKSET_EDF
@@ -120,10 +159,10 @@ static void task3(void) {
 static void task1(void) {
     while(1) {
         /* Task 1 code */
-        printf("\r\n+++++++++++++++++++++++ Task1 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
-        /* Simulate work with delay */
-        HAL_Delay(19);
-        printf("\r\n++++++++++++++++++++++ Task1 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
+        LOG_INFO("\r\n+++++++++++++++++++++++ Task1 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
+        /* Simulate work by burning CPU time */
+        workload_burn_us(19000);
+        LOG_INFO("\r\n++++++++++++++++++++++ Task1 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
         /* Yield as task is finished for current period */
         task_yield();
     }
@@ -133,10 +172,10 @@ static void task1(void) {
 static void task2(void) {
     while(1) {
         /* Task 2 code */
-        printf("\r\n+++++++++++++++++++++++ Task2 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
-        /* Simulate work with delay */
-        HAL_Delay(9);
-        printf("\r\n++++++++++++++++++++++ Task2 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
+        LOG_INFO("\r\n+++++++++++++++++++++++ Task2 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
+        /* Simulate work by burning CPU time */
+        workload_burn_us(9000);
+        LOG_INFO("\r\n++++++++++++++++++++++ Task2 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
         /* Yield as task is finished for current period */
         task_yield();
     }
@@ -146,16 +185,75 @@ static void task2(void) {
 static void task3(void) {
     while(1) {
         /* Task 3 code */
-        printf("\r\n+++++++++++++++++++++++ Task3 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
-        /* Simulate work with delay */
-        HAL_Delay(19);
-        printf("\r\n++++++++++++++++++++++ Task3 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
+        LOG_INFO("\r\n+++++++++++++++++++++++ Task3 started at tick %u +++++++++++++++++++++++\r\n", get_tick());
+        /* Simulate work by burning CPU time */
+        workload_burn_us(19000);
+        LOG_INFO("\r\n++++++++++++++++++++++ Task3 finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
         /* Yield as task is finished for current period */
         task_yield();
     }
 }
+
+/* Task set: period, ~execution time, relative deadline and release offset in milliseconds */
+#define EDF_TASK_TABLE(X) \
+    X(task1, "Task1", MS_TO_TICKS(50), MS_TO_TICKS(20), MS_TO_TICKS(50), 0, 512) \
+    X(task2, "Task2", MS_TO_TICKS(20), MS_TO_TICKS(10), MS_TO_TICKS(20), 0, 512) \
+    X(task3, "Task3", MS_TO_TICKS(40), MS_TO_TICKS(20), MS_TO_TICKS(40), 0, 512)
+#define EDF_TASK_TABLE_HYPERPERIOD MS_TO_TICKS(200)
+/* This task set overloads the CPU on purpose to demonstrate a deadline miss */
+#define EDF_TASK_TABLE_SKIP_SCHEDULABILITY_CHECK
 #endif  /* RUN_UNSCHELUDABLE_TASKSET_EDF */
 
+#ifdef RUN_MIXED_CRITICALITY_EDF
+/* High criticality control loop, every fifth job takes its pessimistic execution time */
+static void control_task(void) {
+    uint32_t job = 0;
+    while(1) {
+        LOG_INFO("\r\n+++++++++++++++++++++++ Control started at tick %u +++++++++++++++++++++++\r\n", get_tick());
+        /* Simulate work by burning CPU time */
+        workload_burn_us((++job % 5 == 0) ? 9000 : 3000);
+        LOG_INFO("\r\n++++++++++++++++++++++ Control finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
+        /* Yield as task is finished for current period */
+        task_yield();
+    }
+}
+
+/* Low criticality task, held back while a control job overruns */
+static void logging_task(void) {
+    while(1) {
+        LOG_INFO("\r\n+++++++++++++++++++++++ Logging started at tick %u +++++++++++++++++++++++\r\n", get_tick());
+        /* Simulate work by burning CPU time */
+        workload_burn_us(9000);
+        LOG_INFO("\r\n++++++++++++++++++++++ Logging finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
+        /* Yield as task is finished for current period */
+        task_yield();
+    }
+}
+
+/* Low criticality task, held back while a control job overruns */
+static void telemetry_task(void) {
+    while(1) {
+        LOG_INFO("\r\n+++++++++++++++++++++++ Telemetry started at tick %u +++++++++++++++++++++++\r\n", get_tick());
+        /* Simulate work by burning CPU time */
+        workload_burn_us(14000);
+        LOG_INFO("\r\n++++++++++++++++++++++ Telemetry finished at tick %u ++++++++++++++++++++++\r\n", get_tick());
+        /* Yield as task is finished for current period */
+        task_yield();
+    }
+}
+
+/* Utilization is 0.75 with optimistic and 1.05 with pessimistic budgets, EDF-VD keeps Control safe */
+/* Offsets from Tools/edf_offsets.py Logging:40:10 Telemetry:50:15 Control:20:4 */
+#define EDF_TASK_TABLE(X) \
+    X(logging_task, "Logging", MS_TO_TICKS(40), MS_TO_TICKS(10), MS_TO_TICKS(40), MS_TO_TICKS(5), 512) \
+    X(telemetry_task, "Telemetry", MS_TO_TICKS(50), MS_TO_TICKS(15), MS_TO_TICKS(50), 0, 512)
+#define EDF_TASK_TABLE_HI(X) \
+    X(control_task, "Control", MS_TO_TICKS(20), MS_TO_TICKS(4), MS_TO_TICKS(10), MS_TO_TICKS(20), MS_TO_TICKS(14), 512)
+#define EDF_TASK_TABLE_HYPERPERIOD MS_TO_TICKS(200)
+#endif  /* RUN_MIXED_CRITICALITY_EDF */
+
+#include "task_table.h"
+
 /**
   * @brief  The application entry point.
   * @retval int
@@ -165,8 +263,13 @@ int main(void)
     /* Disable interrupt first */
     __disable_irq();
 
+#ifdef ENABLE_RAMFUNC
+    vector_table_to_ram();
+#endif /* ENABLE_RAMFUNC */
+
     NVIC_SetPriority(PendSV_IRQn, 0xFF);
 
+    /* Also starts TIM2, the time base of both HAL and the scheduler */
     HAL_Init();
 
     /* Configure the system clock */
@@ -174,88 +277,42 @@ int main(void)
 
     /* Initialize all configured peripherals */
     uart1_logger_init();
-    timer2_tick_init();
+    trace_stream_init();
+    fault_report_last();
+    workload_calibrate();
+    power_init();
 
 #ifdef RUN_NORMAL_SCHELUDABLE_EDF
-    printf("Start: run RUN_NORMAL_SCHELUDABLE_EDF program\r\n");
-    /* Create tasks with their periods (in system ticks) and execution times */
-    create_task(task1, 40, 10, 40, "Task1");    /* 40 ticks period, ~10 ticks execution time, 40 ticks relative deadline */
-    create_task(task2, 40, 5, 30, "Task2");    /* 40 ticks period, ~5 ticks execution time, 30 ticks relative deadline */
-    create_task(task3, 30, 5, 15, "Task3");    /* 30 ticks period, ~5 ticks execution time, 15 ticks relative deadline */
+    LOG_INFO("Start: run RUN_NORMAL_SCHELUDABLE_EDF program\r\n");
 #endif /* RUN_NORMAL_SCHELUDABLE_EDF */
 
 #ifdef RUN_CONCURRENT_SCHELUDABLE_EDF
-    printf("Start: run RUN_CONCURRENT_SCHELUDABLE_EDF program\r\n");
-    /* Create tasks with their periods (in system ticks) and execution times */
-    create_task(task1, 40, 10, 40, "Task1");    /* 32 ticks period, ~10 ticks execution time, 32 ticks relative deadline */
-    create_task(task2, 40, 10, 40, "Task2");    /* 32 ticks period, ~10 ticks execution time, 32 ticks relative deadline */
-    create_task(task3, 40, 10, 40, "Task3");    /* 32 ticks period, ~10 ticks execution time, 32 ticks relative deadline */
+    LOG_INFO("Start: run RUN_CONCURRENT_SCHELUDABLE_EDF program\r\n");
 #endif /* RUN_CONCURRENT_SCHELUDABLE_EDF */
 
 #ifdef RUN_UNSCHELUDABLE_TASKSET_EDF
-    printf("Start: run RUN_UNSCHELUDABLE_TASKSET_EDF program\r\n");
-    /* Create tasks with their periods (in system ticks) and execution times */
-    create_task(task1, 50, 20, 50, "Task1");    /* 50 ticks period, ~20 ticks execution time, 50 ticks relative deadline */
-    create_task(task2, 20, 10, 20, "Task2");    /* 20 ticks period, ~10 ticks execution time, 20 ticks relative deadline */
-    create_task(task3, 40, 20, 40, "Task3");    /* 40 ticks period, ~10 ticks execution time, 40 ticks relative deadline */
+    LOG_INFO("Start: run RUN_UNSCHELUDABLE_TASKSET_EDF program\r\n");
 #endif /* RUN_UNSCHELUDABLE_TASKSET_EDF */
 
+#ifdef RUN_MIXED_CRITICALITY_EDF
+    LOG_INFO("Start: run RUN_MIXED_CRITICALITY_EDF program\r\n");
+#endif /* RUN_MIXED_CRITICALITY_EDF */
+
+    /* Create tasks declared in EDF_TASK_TABLE */
+    task_table_create();
+#ifdef ENABLE_TBS
+    /* Server for aperiodic jobs */
+    tbs_init();
+#endif /* ENABLE_TBS */
+#ifdef ENABLE_CONSOLE
+    /* Command console on USART1 */
+    console_init();
+#endif /* ENABLE_CONSOLE */
+
     /* Start the scheduler */
     start_scheduler();
     /* Should not get here! */
     assert_param(false);
 }
 
-/**
-  * @brief System Clock Configuration
-  * @retval None
-  */
-void SystemClock_Config(void)
-{
-    RCC_OscInitTypeDef RCC_OscInitStruct = {0};
-    RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
-
-    /** Configure the main internal regulator output voltage */
-    __HAL_RCC_PWR_CLK_ENABLE();
-    __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE1);
-    /** Initializes the RCC Oscillators according to the specified parameters in the RCC_OscInitTypeDef structure. */
-    RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSE;
-    RCC_OscInitStruct.HSEState = RCC_HSE_ON;
-    RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
-    RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
-    RCC_OscInitStruct.PLL.PLLM = 8;
-    RCC_OscInitStruct.PLL.PLLN = 336;
-    RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV2;
-    RCC_OscInitStruct.PLL.PLLQ = 7;
-    if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK) {
-        assert_param(false);
-    }
-    /** Initializes the CPU, AHB and APB buses clocks */
-    RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
-        |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
-    RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
-    RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
-    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV4;
-    RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV2;
-
-    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_5) != HAL_OK) {
-        assert_param(false);
-    }
-}
-
-#ifdef  USE_FULL_ASSERT
-/**
-  * @brief  Reports the name of the source file and the source line number
-  *         where the assert_param error has occurred.
-  * @param  file: pointer to the source file name
-  * @param  line: assert_param error line source number
-  * @retval None
-  */
-void assert_failed(uint8_t *file, uint32_t line) {
-    __disable_irq();
-    printf("assert failed: at %s, line %u\r\n", file, line);
-    while(1);
-}
-#endif /* USE_FULL_ASSERT */
-
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,132 @@
+#include "main.h"
+#include "notify.h"
+
+static volatile uint32_t notify_value[MAX_TASKS];
+static volatile uint32_t notify_waiters = 0;    /* Bit i is set while task i waits on its word */
+
+/* What a waiting task waits for */
+static uint32_t wait_mask[MAX_TASKS];
+static bool wait_all[MAX_TASKS];
+
+static bool bits_match(uint32_t value, uint32_t mask, bool all) {
+    return all ? (value & mask) == mask : (value & mask) != 0;
+}
+
+static uint32_t job_deadline(uint8_t task_id) {
+    return (tasks[task_id].deadline_period == TASK_NO_DEADLINE)
+            ? TASK_NO_DEADLINE : get_tick() + tasks[task_id].deadline_period;
+}
+
+/* Release a task that waited for an event as a new job */
+static void release_waiter(uint8_t task_id) {
+    task_wake(task_id, job_deadline(task_id));
+}
+
+/* A task that did not have to wait still starts a new job, with its release time and budget reset */
+static void restart_job(uint8_t task_id) {
+    task_restart_job(job_deadline(task_id));
+}
+
+/* Set bits in the notification word of a task, safe from interrupts */
+void notify_give(uint8_t task_id, uint32_t bits) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    notify_value[task_id] |= bits;
+    if ((notify_waiters & (1UL << task_id)) && bits_match(notify_value[task_id], wait_mask[task_id], false)) {
+        notify_waiters &= ~(1UL << task_id);
+        release_waiter(task_id);
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/* Forget the notification state of a deleted task, event groups must not have it waiting */
+void notify_clear(uint8_t task_id) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    notify_value[task_id] = 0;
+    notify_waiters &= ~(1UL << task_id);
+    __set_PRIMASK(primask);
+}
+
+/* Wait until any bit of mask is set in the own notification word */
+/* Returns the matching bits and clears them */
+uint32_t notify_wait(uint32_t mask) {
+    uint8_t task_id = task_get_current_id();
+    bool waited = false;
+
+    __disable_irq();
+    while ((notify_value[task_id] & mask) == 0) {
+        wait_mask[task_id] = mask;
+        notify_waiters |= 1UL << task_id;
+        task_wait();
+        /* The switch happens here, once interrupts are enabled */
+        __enable_irq();
+        __disable_irq();
+        waited = true;
+    }
+    if (!waited) {
+        restart_job(task_id);
+    }
+    uint32_t bits = notify_value[task_id] & mask;
+    notify_value[task_id] &= ~bits;
+    __enable_irq();
+
+    return bits;
+}
+
+/* Set bits of an event group and release the tasks they satisfy, safe from interrupts */
+void event_group_set(event_group_t *group, uint32_t bits) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    group->bits |= bits;
+    uint32_t waiters = group->waiters;
+    while (waiters != 0) {
+        uint8_t task_id = (uint8_t)__CLZ(__RBIT(waiters));
+        waiters &= ~(1UL << task_id);
+        if (bits_match(group->bits, wait_mask[task_id], wait_all[task_id])) {
+            group->waiters &= ~(1UL << task_id);
+            release_waiter(task_id);
+        }
+    }
+
+    __set_PRIMASK(primask);
+}
+
+void event_group_clear(event_group_t *group, uint32_t bits) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    group->bits &= ~bits;
+    __set_PRIMASK(primask);
+}
+
+/* Wait until any (or all, with wait_all) bits of mask are set in the group */
+/* Returns the group bits at wake up, the masked bits are cleared if clear_on_exit */
+uint32_t event_group_wait(event_group_t *group, uint32_t mask, bool wait_all_bits, bool clear_on_exit) {
+    uint8_t task_id = task_get_current_id();
+    bool waited = false;
+
+    __disable_irq();
+    while (!bits_match(group->bits, mask, wait_all_bits)) {
+        wait_mask[task_id] = mask;
+        wait_all[task_id] = wait_all_bits;
+        group->waiters |= 1UL << task_id;
+        task_wait();
+        /* The switch happens here, once interrupts are enabled */
+        __enable_irq();
+        __disable_irq();
+        waited = true;
+    }
+    if (!waited) {
+        restart_job(task_id);
+    }
+    uint32_t bits = group->bits;
+    if (clear_on_exit) {
+        group->bits &= ~mask;
+    }
+    __enable_irq();
+
+    return bits;
+}
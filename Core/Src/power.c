@@ -0,0 +1,137 @@
+#include "main.h"
+#include "power.h"
+#include "timer2_tick.h"
+#include <string.h>
+
+static power_stats_t power_stats;
+
+#ifdef IDLE_ENABLE_STOP_MODE
+/* RTC wakeup counts used to measure the LSI frequency */
+#define RTC_CALIBRATION_COUNTS 100
+
+static RTC_HandleTypeDef hrtc;
+/* Measured RTC wakeup timer frequency (LSI / 16) */
+static uint32_t rtc_wakeup_hz = 0;
+
+/* Clock the RTC from LSI and measure its wakeup timer against TIM2 */
+static void rtc_wakeup_init(void) {
+    RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+    RCC_PeriphCLKInitTypeDef PeriphClkInitStruct = {0};
+
+    HAL_PWR_EnableBkUpAccess();
+
+    RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_LSI;
+    RCC_OscInitStruct.PLL.PLLState = RCC_PLL_NONE;
+    RCC_OscInitStruct.LSIState = RCC_LSI_ON;
+    if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK) {
+        assert_param(false);
+    }
+
+    PeriphClkInitStruct.PeriphClockSelection = RCC_PERIPHCLK_RTC;
+    PeriphClkInitStruct.RTCClockSelection = RCC_RTCCLKSOURCE_LSI;
+    if (HAL_RCCEx_PeriphCLKConfig(&PeriphClkInitStruct) != HAL_OK) {
+        assert_param(false);
+    }
+    __HAL_RCC_RTC_ENABLE();
+
+    hrtc.Instance = RTC;
+    hrtc.Init.HourFormat = RTC_HOURFORMAT_24;
+    hrtc.Init.AsynchPrediv = 127;
+    hrtc.Init.SynchPrediv = 249;
+    hrtc.Init.OutPut = RTC_OUTPUT_DISABLE;
+    hrtc.Init.OutPutPolarity = RTC_OUTPUT_POLARITY_HIGH;
+    hrtc.Init.OutPutType = RTC_OUTPUT_TYPE_OPENDRAIN;
+    if (HAL_RTC_Init(&hrtc) != HAL_OK) {
+        assert_param(false);
+    }
+
+    /* LSI is only accurate to about +-50%, time a few wakeup periods with TIM2 */
+    if (HAL_RTCEx_SetWakeUpTimer(&hrtc, RTC_CALIBRATION_COUNTS - 1, RTC_WAKEUPCLOCK_RTCCLK_DIV16) != HAL_OK) {
+        assert_param(false);
+    }
+    uint32_t start = timer2_get_counter();
+    while (__HAL_RTC_WAKEUPTIMER_GET_FLAG(&hrtc, RTC_FLAG_WUTF) == RESET);
+    uint32_t elapsed = timer2_get_counter() - start;
+    HAL_RTCEx_DeactivateWakeUpTimer(&hrtc);
+    __HAL_RTC_WAKEUPTIMER_CLEAR_FLAG(&hrtc, RTC_FLAG_WUTF);
+
+    rtc_wakeup_hz = (uint32_t)((uint64_t)RTC_CALIBRATION_COUNTS * TIMER2_COUNTER_HZ / elapsed);
+
+    HAL_NVIC_SetPriority(RTC_WKUP_IRQn, TICK_INT_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(RTC_WKUP_IRQn);
+}
+
+/* Enter STOP mode for about the given number of ticks, returns the ticks actually accounted */
+static uint32_t enter_stop(uint32_t ticks) {
+    uint32_t counts = (uint32_t)((uint64_t)ticks * rtc_wakeup_hz / TIMER2_COUNTER_HZ);
+    if (counts == 0) {
+        return 0;
+    }
+    if (counts > 0x10000) {
+        counts = 0x10000;
+    }
+
+    if (HAL_RTCEx_SetWakeUpTimer_IT(&hrtc, counts - 1, RTC_WAKEUPCLOCK_RTCCLK_DIV16) != HAL_OK) {
+        return 0;
+    }
+
+    HAL_SuspendTick();
+    HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+
+    /* Woken up on HSI, bring back HSE and PLL */
+    SystemClock_Config();
+    HAL_RTCEx_DeactivateWakeUpTimer(&hrtc);
+
+    /* TIM2 was halted, move the scheduler time forward by the time spent stopped */
+    uint32_t slept = (uint32_t)((uint64_t)counts * TIMER2_COUNTER_HZ / rtc_wakeup_hz);
+    timer2_advance(slept);
+    HAL_ResumeTick();
+
+    return slept;
+}
+
+void RTC_WKUP_IRQHandler(void) {
+    HAL_RTCEx_WakeUpTimerIRQHandler(&hrtc);
+}
+#endif /* IDLE_ENABLE_STOP_MODE */
+
+void power_init(void) {
+#ifdef IDLE_ENABLE_STOP_MODE
+    rtc_wakeup_init();
+#endif
+}
+
+/* Sleep until the next interrupt, picking the sleep depth from the time left until wake_time */
+/* Call with interrupts disabled, pending interrupts are served once the caller enables them */
+void power_idle(bool has_wake_time, uint32_t wake_time) {
+    uint32_t start = timer2_get_counter();
+    uint8_t depth = POWER_SLEEP;
+
+#ifdef IDLE_ENABLE_STOP_MODE
+    if (has_wake_time && (int32_t)(wake_time - start) >= (int32_t)IDLE_STOP_MIN_TICKS) {
+        if (enter_stop(wake_time - start - IDLE_STOP_EXIT_TICKS) != 0) {
+            depth = POWER_STOP;
+        }
+    }
+#endif
+
+    if (depth == POWER_SLEEP) {
+        __DSB();
+        __WFI();
+    }
+
+    uint32_t now = timer2_get_counter();
+    power_stats.entries[depth]++;
+    power_stats.residency[depth] += now - start;
+
+    if (has_wake_time && (int32_t)(now - wake_time) >= 0 && now - wake_time > power_stats.max_wakeup_latency) {
+        power_stats.max_wakeup_latency = now - wake_time;
+    }
+}
+
+void power_get_stats(power_stats_t *stats) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memcpy(stats, &power_stats, sizeof(power_stats));
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,43 @@
+#include "main.h"
+#include "task.h"
+#include "stack_guard.h"
+#include <stdio.h>
+
+/* Set up the guard region and enable the MPU, call before the first task runs */
+void stack_guard_init(void) {
+    MPU->CTRL = 0;
+
+    /* No access, never executable, 2^(4 + 1) = 32 bytes */
+    MPU->RNR = STACK_GUARD_REGION;
+    MPU->RBAR = 0;
+    MPU->RASR = MPU_RASR_XN_Msk
+            | (0U << MPU_RASR_AP_Pos)
+            | (4U << MPU_RASR_SIZE_Pos)
+            | MPU_RASR_ENABLE_Msk;
+
+    /* Outside the guard the default memory map applies */
+    MPU->CTRL = MPU_CTRL_PRIVDEFENA_Msk | MPU_CTRL_ENABLE_Msk;
+
+    /* Report violations as MemManage faults rather than HardFaults */
+    SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk;
+
+    __DSB();
+    __ISB();
+}
+
+/* Called on a fault, MemManage faults with interrupts masked arrive as HardFault */
+void stack_guard_report_fault(void) {
+    uint32_t mmfsr = (SCB->CFSR & SCB_CFSR_MEMFAULTSR_Msk) >> SCB_CFSR_MEMFAULTSR_Pos;
+    if (mmfsr == 0) {
+        return;
+    }
+
+    uint8_t task_id = task_get_current_id();
+    const char *name = (task_id < num_tasks) ? tasks[task_id].name : "none";
+
+    printf("\r\n!!!!! Stack overflow in task %s (MMFSR 0x%02x", name, (unsigned int)mmfsr);
+    if (mmfsr & (SCB_CFSR_MMARVALID_Msk >> SCB_CFSR_MEMFAULTSR_Pos)) {
+        printf(", address 0x%08x", (unsigned int)SCB->MMFAR);
+    }
+    printf(") !!!!!\r\n");
+}
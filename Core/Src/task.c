@@ -1,67 +1,231 @@
 #include "task.h"
 #include "timer2_tick.h"
 #include "main.h"
+#include "power.h"
+#include "cpu_load.h"
+#include "notify.h"
+#include "stack_guard.h"
+#include "trace.h"
+#include "latency.h"
+#include "ramfunc.h"
 #include <stdbool.h>
+#include <stdio.h>
+
+#ifndef LOG_LEVEL_TASK
+#define LOG_LEVEL_TASK LOG_LEVEL
+#endif
+#define LOG_MODULE_LEVEL LOG_LEVEL_TASK
+#include "log.h"
 
 /* Task management */
 TCB_t tasks[MAX_TASKS];
 uint8_t num_tasks = 0;
 uint8_t current_task_id = 0;
 bool first_context_switch = true;
-static volatile uint32_t system_ticks = 0;
+static uint8_t idle_task_id = 0xFF;
+static uint32_t dispatch_time = 0;    /* When the current task was switched in */
+static uint32_t crit_mode = TASK_CRIT_LO;    /* LO tasks only run in LO mode */
+
+/* Tasks with a pending deadline as a list sorted by deadline, only its head is checked for misses */
+static uint8_t deadline_head = 0xFF;
+static uint8_t deadline_next[MAX_TASKS];
+static bool deadline_queued[MAX_TASKS];
+
+/* Tasks woken with a new deadline, bit i for task i, sorted into the queue by the next tick */
+/* so that task_wake() stays O(1) in interrupt context */
+_Static_assert(MAX_TASKS <= 32, "woken tasks are kept in a 32-bit mask");
+static uint32_t deadline_pending = 0;
 
 static void idle_task_func(void);
-static const char* get_task_state_str(uint8_t task_id);
+static void schedule_next_task(uint32_t now);
+static void request_tick_at(uint32_t time);
+static bool npr_schedulable(const task_config_t *config, bool verbose);
+static void deadline_queue_update(uint8_t task_id);
+static void deadline_queue_remove(uint8_t task_id);
+static bool admission_test(const task_config_t *config);
+static void edf_vd_update(bool verbose);
+static bool task_has_demand(uint8_t task_id);
+
+/* Pend PendSV, the switch happens as soon as interrupts allow */
+static inline void request_context_switch(void) {
+#ifdef ENABLE_LATENCY_STATS
+    latency_switch_requested();
+#endif /* ENABLE_LATENCY_STATS */
+    SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;
+}
+
+/* Slots of deleted tasks, reused before num_tasks grows */
+static uint8_t free_task_ids[MAX_TASKS];
+static uint8_t num_free_task_ids = 0;
+static bool scheduler_started = false;
+
+/* Stacks handed out by create_task() */
+#if TASK_STACK_POOL_SIZE > 0
+static uint32_t task_stack_pool[TASK_STACK_POOL_SIZE][STACK_SIZE] __attribute__((aligned(TASK_STACK_ALIGN)));
+static uint8_t num_pool_stacks = 0;
+/* Pool stacks given back by task_delete() */
+static uint8_t free_pool_stacks[TASK_STACK_POOL_SIZE];
+static uint8_t num_free_pool_stacks = 0;
+#endif
+
+/* Stack of the idle task */
+static uint32_t idle_task_stack[IDLE_STACK_SIZE] __attribute__((aligned(TASK_STACK_ALIGN)));
 
 /* Initialize task control block */
-int create_task(void (*task_func)(void), uint32_t period, uint32_t execution_time, uint32_t deadline_period, const char *name) {
-    if (num_tasks >= MAX_TASKS) {
+int create_task(void (*task_func)(void), uint32_t period, uint32_t execution_time, uint32_t deadline_period,
+                uint32_t offset, const char *name) {
+#if TASK_STACK_POOL_SIZE > 0
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t stack_index;
+    if (num_free_pool_stacks > 0) {
+        stack_index = free_pool_stacks[--num_free_pool_stacks];
+    }
+    else if (num_pool_stacks < TASK_STACK_POOL_SIZE) {
+        stack_index = num_pool_stacks++;
+    }
+    else {
+        __set_PRIMASK(primask);
         return 0xFF; /* No space for new task */
     }
+    __set_PRIMASK(primask);
 
-    uint8_t task_id = num_tasks++;
-    TCB_t *task = &tasks[task_id];
+    task_config_t config = {
+        .task_func = task_func,
+        .name = name,
+        .period = period,
+        .execution_time = execution_time,
+        .deadline_period = deadline_period,
+        .offset = offset,
+        .stack = task_stack_pool[stack_index],
+        .stack_size = STACK_SIZE,
+    };
+
+    int task_id = create_task_static(&config);
+    if (task_id == 0xFF) {
+        primask = __get_PRIMASK();
+        __disable_irq();
+        free_pool_stacks[num_free_pool_stacks++] = stack_index;
+        __set_PRIMASK(primask);
+    }
+    return task_id;
+#else
+    /* No stack pool, tasks must be created with create_task_static() */
+    return 0xFF;
+#endif
+}
 
-    /* Initialize stack with default values */
-    memset(task->stack, 0, sizeof(task->stack));
+/* Point the task stack at a fresh exception frame that starts the task function */
+static void init_stack_frame(TCB_t *task) {
+    uint32_t *stack = task->stack_base;
+    uint32_t stack_size = task->stack_size;
 
-    /* Set initial stack pointer to point to the end of the stack */
-    task->stack_ptr = &task->stack[STACK_SIZE - 16];
+    /* Set initial stack pointer below the exception frame and the registers saved by PendSV_Handler */
+    task->stack_ptr = &stack[stack_size - 17];
 
     /* Set up initial stack frame */
-    task->stack[STACK_SIZE - 1] = 0x01000000;      /* PSR (T-bit set for Thumb mode) */
-    task->stack[STACK_SIZE - 2] = (uint32_t)task_func;  /* PC */
-    task->stack[STACK_SIZE - 3] = 0xFFFFFFFF;      /* LR (dummy return address) */
+    stack[stack_size - 1] = 0x01000000;      /* PSR (T-bit set for Thumb mode) */
+    stack[stack_size - 2] = (uint32_t)task->task_func;  /* PC */
+    stack[stack_size - 3] = 0xFFFFFFFF;      /* LR (dummy return address) */
+    stack[stack_size - 9] = 0xFFFFFFFD;      /* EXC_RETURN: thread mode on PSP, no FPU state */
+}
 
-    /* Initialize task parameters */
-    task->state = TASK_READY;
-    task->period = period;
-    task->deadline_period = deadline_period;
-    task->execution_time = execution_time;
-    if (deadline_period == 0xFFFFFFFF)
-        task->deadline = deadline_period;
+/* Set up the first job of a task, released offset ticks after the given time */
+static void release_first_job(uint8_t task_id, uint32_t time) {
+    TCB_t *task = &tasks[task_id];
+
+    task->release_time = time + task->offset;
+    task->wake_time = task->release_time;
+    if (task->deadline_period == TASK_NO_DEADLINE)
+        task->deadline = task->deadline_period;
     else
-        task->deadline = system_ticks + deadline_period;  /* Initial deadline */
-    task->wait_time = 0;    /* Start executing immediately */
-    task->task_func = task_func;
+        task->deadline = task->release_time + task->deadline_period;
+    /* Without offset the task starts executing immediately */
+    task->state = (task->offset == 0) ? TASK_READY : TASK_BLOCKED;
+    deadline_queue_update(task_id);
+    if (task->state == TASK_BLOCKED) {
+        request_tick_at(task->wake_time);
+    }
+}
+
+/* Initialize task control block on a caller provided stack */
+/* The stack is not cleared here, only the initial frame is written */
+/* Once the scheduler runs, the task is only admitted if the task set stays schedulable */
+int create_task_static(const task_config_t *config) {
+    if (config->stack_size < TASK_MIN_STACK_SIZE || ((uint32_t)config->stack % TASK_STACK_ALIGN) != 0) {
+        return 0xFF;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (scheduler_started && !admission_test(config)) {
+        __set_PRIMASK(primask);
+        LOG_WARN("\r\n!!!!! Task %s rejected by admission control !!!!!\r\n", config->name);
+        return 0xFF;
+    }
+
+    uint8_t task_id;
+    if (num_free_task_ids > 0) {
+        task_id = free_task_ids[--num_free_task_ids];
+    }
+    else if (num_tasks < MAX_TASKS) {
+        task_id = num_tasks++;
+    }
+    else {
+        __set_PRIMASK(primask);
+        return 0xFF; /* No space for new task */
+    }
+
+    TCB_t *task = &tasks[task_id];
+    uint32_t *stack = config->stack;
+    uint32_t stack_size = config->stack_size;
 
-    /* Copy task name */
-    strncpy(task->name, name, sizeof(task->name) - 1);
-    task->name[sizeof(task->name) - 1] = '\0'; /* Ensure null termination */
+    task->stack_base = stack;
+    task->stack_size = stack_size;
+    task->task_func = config->task_func;
+    init_stack_frame(task);
 
-    printf("\r\n*** Create task: %s ***\r\n", task->name);
-    printf("\t- Current ticks %u,\r\n", system_ticks);
-    printf("\t- state %u,\r\n", task->state);
-    printf("\t- period %u,\r\n", task->period);
-    printf("\t- xc time %u,\r\n", task->execution_time);
-    printf("\t- deadline at %u\r\n", task->deadline);
+    /* Initialize task parameters */
+    task->period = config->period;
+    task->deadline_period = config->deadline_period;
+    task->execution_time = config->execution_time;
+    task->criticality = config->criticality;
+    task->execution_time_hi = config->execution_time_hi ? config->execution_time_hi : config->execution_time;
+    task->virtual_deadline_period = config->deadline_period;
+    task->job_run_time = 0;
+    task->npr_length = config->npr_length;
+    task->npr_active = false;
+    task->miss_policy = config->miss_policy;
+    task->miss_handler = config->miss_handler;
+    task->miss_count = 0;
+    task->late = false;
+    task->abort_pending = false;
+    task->offset = (config->deadline_period == TASK_NO_DEADLINE) ? 0 : config->offset;
+    task->name = config->name;
+    /* run_time keeps counting across reuse of the slot, CPU load windows work on differences */
+    release_first_job(task_id, get_tick());
+
+    if (scheduler_started) {
+        edf_vd_update(false);
+        request_context_switch();
+    }
+    __set_PRIMASK(primask);
+
+    LOG_INFO("\r\n*** Create task: %s ***\r\n", task->name);
+    LOG_INFO("\t- Current ticks %u,\r\n", task->release_time - task->offset);
+    LOG_INFO("\t- offset %u,\r\n", task->offset);
+    LOG_INFO("\t- state %u,\r\n", task->state);
+    LOG_INFO("\t- period %u,\r\n", task->period);
+    LOG_INFO("\t- xc time %u,\r\n", task->execution_time);
+    LOG_INFO("\t- deadline at %u\r\n", task->deadline);
 
     return task_id;
 }
 
-/* return how many ticks has passed */
-uint32_t get_tick(void) {
-    return system_ticks;
+/* return how many ticks has passed, wraps around after 2^32 ticks */
+RAMFUNC uint32_t get_tick(void) {
+    return timer2_get_counter();
 }
 
 /* After task finished executing for one period, should call yield */
@@ -69,143 +233,687 @@ uint32_t get_tick(void) {
 void task_yield(void) {
     /* Voluntarily yield by blocking this task */
     __disable_irq();
-    tasks[current_task_id].deadline = system_ticks + tasks[current_task_id].period + tasks[current_task_id].deadline_period - tasks[current_task_id].execution_time;
-    tasks[current_task_id].wait_time = tasks[current_task_id].period - tasks[current_task_id].execution_time;
+    /* Next job is released one period after the current one, independent of when this job ran */
+    tasks[current_task_id].release_time += tasks[current_task_id].period;
+    tasks[current_task_id].deadline = tasks[current_task_id].release_time + tasks[current_task_id].deadline_period;
+    tasks[current_task_id].wake_time = tasks[current_task_id].release_time;
+    tasks[current_task_id].job_run_time = 0;
+    tasks[current_task_id].late = false;
+    tasks[current_task_id].npr_active = false;
     tasks[current_task_id].state = TASK_BLOCKED;
-    SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;
+    trace_record(TRACE_COMPLETE, current_task_id, 0);
+    deadline_queue_update(current_task_id);
+    request_tick_at(tasks[current_task_id].wake_time);
+    request_context_switch();
+    __enable_irq();
+}
+
+/* Block the current job until the given absolute time, the CPU goes to other jobs meanwhile */
+/* The job keeps its deadline, use task_yield() to finish a job */
+void task_sleep_until(uint32_t wake_time) {
+    __disable_irq();
+    if (time_before(get_tick(), wake_time)) {
+        tasks[current_task_id].wake_time = wake_time;
+        tasks[current_task_id].state = TASK_BLOCKED;
+        request_tick_at(wake_time);
+        request_context_switch();
+    }
     __enable_irq();
 }
 
+/* Block the current job for the given number of ticks */
+void task_delay(uint32_t ticks) {
+    task_sleep_until(get_tick() + ticks);
+}
+
+/* Block the current task until another task or an interrupt calls task_wake() */
+/* Interrupts may be disabled by the caller to check its wait condition atomically */
+void task_wait(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    tasks[current_task_id].state = TASK_WAITING;
+    request_context_switch();
+    __set_PRIMASK(primask);
+}
+
+/* Release a waiting task as a new job with the given absolute deadline, safe from interrupts */
+void task_wake(uint8_t task_id, uint32_t deadline) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (tasks[task_id].state == TASK_WAITING) {
+        tasks[task_id].release_time = get_tick();
+        tasks[task_id].deadline = deadline;
+        tasks[task_id].job_run_time = 0;
+        tasks[task_id].late = false;
+        tasks[task_id].state = TASK_READY;
+        if (tasks[task_id].deadline_period != TASK_NO_DEADLINE) {
+            /* The tick handler queues it before it looks for misses */
+            deadline_pending |= 1UL << task_id;
+            request_tick_at(deadline);
+        }
+        trace_record(TRACE_RELEASE, task_id, 0);
+        request_context_switch();
+    }
+    __set_PRIMASK(primask);
+}
+
+/* Start a new job of the running task that did not have to wait, released now like task_wake() */
+void task_restart_job(uint32_t deadline) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t now = get_tick();
+    TCB_t *task = &tasks[current_task_id];
+
+    /* The slice so far belongs to the previous job */
+    task->run_time += now - dispatch_time;
+    dispatch_time = now;
+
+    task->release_time = now;
+    task->deadline = deadline;
+    task->job_run_time = 0;
+    task->late = false;
+    task->abort_pending = false;
+    task->npr_active = false;
+    deadline_queue_update(current_task_id);
+    trace_record(TRACE_RELEASE, current_task_id, 0);
+    request_context_switch();
+    __set_PRIMASK(primask);
+}
+
+/* Change the absolute deadline of a task and reschedule */
+void task_set_deadline(uint8_t task_id, uint32_t deadline) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    tasks[task_id].deadline = deadline;
+    deadline_queue_update(task_id);
+    request_context_switch();
+    __set_PRIMASK(primask);
+}
+
+/* Choose what happens when a job of the task misses its deadline */
+void task_set_miss_policy(uint8_t task_id, uint32_t policy, task_miss_handler_t handler) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    tasks[task_id].miss_policy = policy;
+    tasks[task_id].miss_handler = handler;
+    __set_PRIMASK(primask);
+}
+
+uint32_t task_get_miss_count(uint8_t task_id) {
+    return tasks[task_id].miss_count;
+}
+
+/* Let the task run up to npr_length ticks before it is preempted by an earlier deadline, call before start_scheduler() */
+void task_set_npr_length(uint8_t task_id, uint32_t npr_length) {
+    tasks[task_id].npr_length = npr_length;
+}
+
+/* True if the running job is past its deadline (TASK_MISS_CONTINUE) */
+bool task_is_late(void) {
+    return tasks[current_task_id].late;
+}
+
+static RAMFUNC void deadline_queue_remove(uint8_t task_id) {
+    deadline_pending &= ~(1UL << task_id);
+    if (!deadline_queued[task_id]) {
+        return;
+    }
+    uint8_t *link = &deadline_head;
+    while (*link != task_id) {
+        link = &deadline_next[*link];
+    }
+    *link = deadline_next[task_id];
+    deadline_queued[task_id] = false;
+}
+
+/* (Re)insert a task after its deadline changed, interrupts must be disabled */
+static RAMFUNC void deadline_queue_update(uint8_t task_id) {
+    deadline_queue_remove(task_id);
+    if (tasks[task_id].deadline_period == TASK_NO_DEADLINE) {
+        return;
+    }
+
+    uint8_t *link = &deadline_head;
+    while (*link != 0xFF && !time_before(tasks[task_id].deadline, tasks[*link].deadline)) {
+        link = &deadline_next[*link];
+    }
+    deadline_next[task_id] = *link;
+    *link = task_id;
+    deadline_queued[task_id] = true;
+
+    /* The tick handler looks for misses when the head deadline passes */
+    if (link == &deadline_head) {
+        request_tick_at(tasks[task_id].deadline);
+    }
+}
+
+/* Queue the tasks woken since the last tick */
+static RAMFUNC void deadline_queue_flush(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    while (deadline_pending != 0) {
+        deadline_queue_update((uint8_t)__CLZ(__RBIT(deadline_pending)));
+    }
+    __set_PRIMASK(primask);
+}
+
+/* Drop the current job of a task and release it again at the first period whose deadline is still ahead */
+static void abort_job(uint8_t task_id, uint32_t now) {
+    TCB_t *task = &tasks[task_id];
+
+    do {
+        task->release_time += task->period;
+    } while (time_after_eq(now, task->release_time + task->deadline_period));
+    task->deadline = task->release_time + task->deadline_period;
+    task->wake_time = task->release_time;
+    task->job_run_time = 0;
+    task->late = false;
+    task->state = TASK_BLOCKED;
+    deadline_queue_update(task_id);
+    request_tick_at(task->wake_time);
+
+    if (task_id == current_task_id) {
+        /* Its registers are still live, restart it once PendSV has saved them */
+        task->abort_pending = true;
+    }
+    else {
+        init_stack_frame(task);
+    }
+}
+
+/* Apply the miss policy of a task whose deadline has passed */
+static void handle_deadline_miss(uint8_t task_id, uint32_t now) {
+    TCB_t *task = &tasks[task_id];
+    uint32_t policy = task->miss_policy;
+
+    task->miss_count++;
+    trace_record(TRACE_MISS, task_id, (uint16_t)task->miss_count);
+    LOG_ERROR("\r\n!!!!! Task %s cannot meet deadline of %u ticks (%u misses) !!!!!\r\n",
+            task->name,
+            task->deadline,
+            task->miss_count);
+
+    if (policy == TASK_MISS_CALLBACK) {
+        policy = (task->miss_handler != NULL) ? task->miss_handler(task_id) : TASK_MISS_HALT;
+    }
+
+    if (policy == TASK_MISS_ABORT) {
+        abort_job(task_id, now);
+        return;
+    }
+
+    if (policy == TASK_MISS_HALT) {
+        assert_param(false);
+    }
+
+    /* Continue: the job keeps running with its passed deadline and is not reported again */
+    task->late = true;
+    deadline_queue_remove(task_id);
+}
+
+/* Mark a task as high criticality with a pessimistic WCET, call before start_scheduler() */
+/* The task's execution_time becomes its optimistic budget, overrunning it switches to HI mode */
+void task_set_criticality(uint8_t task_id, uint32_t criticality, uint32_t execution_time_hi) {
+    tasks[task_id].criticality = criticality;
+    tasks[task_id].execution_time_hi = (criticality == TASK_CRIT_HI) ? execution_time_hi : tasks[task_id].execution_time;
+}
+
+uint32_t task_get_criticality_mode(void) {
+    return crit_mode;
+}
+
+/* Remove a task and recycle its slot and pool stack, call from task context only */
+/* A task may delete itself with interrupts enabled, it does not return then */
+bool task_delete(uint8_t task_id) {
+    if (task_id >= num_tasks || task_id == idle_task_id || tasks[task_id].state == TASK_FREE) {
+        return false;
+    }
+    bool self = scheduler_started && task_id == current_task_id;
+    if (self && __get_PRIMASK()) {
+        /* The switch away would be deferred and the task would run on in a free slot */
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    deadline_queue_remove(task_id);
+    notify_clear(task_id);
+    tasks[task_id].state = TASK_FREE;
+    tasks[task_id].abort_pending = false;
+    tasks[task_id].npr_active = false;
+    free_task_ids[num_free_task_ids++] = task_id;
+
+#if TASK_STACK_POOL_SIZE > 0
+    uint32_t *stack = tasks[task_id].stack_base;
+    if (stack >= task_stack_pool[0] && stack < task_stack_pool[TASK_STACK_POOL_SIZE]) {
+        free_pool_stacks[num_free_pool_stacks++] = (uint8_t)((stack - task_stack_pool[0]) / STACK_SIZE);
+    }
+#endif
+
+    if (scheduler_started) {
+        edf_vd_update(false);
+    }
+    request_context_switch();
+    __set_PRIMASK(primask);
+
+    if (self) {
+        /* PendSV takes over here and never comes back to a deleted task */
+        while (1);
+    }
+
+    return true;
+}
+
+/* Stop a task until task_resume(), its current job is kept but no longer counts as load */
+bool task_suspend(uint8_t task_id) {
+    if (task_id >= num_tasks || task_id == idle_task_id
+            || tasks[task_id].state == TASK_FREE || tasks[task_id].state == TASK_SUSPENDED) {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    deadline_queue_remove(task_id);
+    tasks[task_id].state = TASK_SUSPENDED;
+    if (scheduler_started) {
+        edf_vd_update(false);
+    }
+    request_context_switch();
+    __set_PRIMASK(primask);
+
+    return true;
+}
+
+/* Continue a suspended task with a job released now, if the task set stays schedulable */
+bool task_resume(uint8_t task_id) {
+    if (task_id >= num_tasks || tasks[task_id].state != TASK_SUSPENDED) {
+        return false;
+    }
+
+    task_config_t config = {
+        .period = tasks[task_id].period,
+        .execution_time = tasks[task_id].execution_time,
+        .deadline_period = tasks[task_id].deadline_period,
+        .npr_length = tasks[task_id].npr_length,
+        .criticality = tasks[task_id].criticality,
+        .execution_time_hi = tasks[task_id].execution_time_hi,
+    };
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (scheduler_started && !admission_test(&config)) {
+        __set_PRIMASK(primask);
+        LOG_WARN("\r\n!!!!! Task %s not resumed, rejected by admission control !!!!!\r\n", tasks[task_id].name);
+        return false;
+    }
+
+    TCB_t *task = &tasks[task_id];
+    uint32_t now = get_tick();
+    task->release_time = now;
+    task->wake_time = now;
+    if (task->deadline_period != TASK_NO_DEADLINE) {
+        task->deadline = now + task->deadline_period;
+    }
+    task->job_run_time = 0;
+    task->late = false;
+    task->state = TASK_READY;
+    deadline_queue_update(task_id);
+
+    if (scheduler_started) {
+        edf_vd_update(false);
+    }
+    request_context_switch();
+    __set_PRIMASK(primask);
+
+    return true;
+}
+
+/* Make sure a tick interrupt happens no later than the given time */
+static RAMFUNC void request_tick_at(uint32_t time) {
+    if (time_before(time, timer2_get_next_event())) {
+        timer2_set_next_event(time);
+    }
+}
+
+/* Deadline EDF orders a task by, HI tasks use their virtual deadline in LO mode */
+static uint32_t scheduling_deadline(uint8_t task_id) {
+    if (crit_mode == TASK_CRIT_LO && tasks[task_id].criticality == TASK_CRIT_HI) {
+        return tasks[task_id].release_time + tasks[task_id].virtual_deadline_period;
+    }
+    return tasks[task_id].deadline;
+}
+
+/* A HI job ran past its optimistic budget, only HI tasks run from now on */
+static void switch_to_hi_mode(uint32_t now) {
+    crit_mode = TASK_CRIT_HI;
+    trace_record(TRACE_MODE, current_task_id, TASK_CRIT_HI);
+    LOG_WARN("\r\n##### Task %s overran its LO budget, criticality mode HI at ticks %u #####\r\n",
+            tasks[current_task_id].name, now);
+}
+
+/* No HI job is pending, resume LO tasks with fresh deadlines for the jobs that were held back */
+static void switch_to_lo_mode(uint32_t now) {
+    crit_mode = TASK_CRIT_LO;
+    trace_record(TRACE_MODE, 0xFF, TASK_CRIT_LO);
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        /* Suspended and deleted tasks are out of the deadline queue and stay out */
+        if (tasks[i].criticality == TASK_CRIT_LO && task_has_demand(i)
+                && tasks[i].state != TASK_WAITING && time_after_eq(now, tasks[i].deadline)) {
+            tasks[i].release_time = now;
+            tasks[i].deadline = now + tasks[i].deadline_period;
+            deadline_queue_update(i);
+        }
+    }
+    LOG_WARN("\r\n##### Criticality mode LO at ticks %u #####\r\n", now);
+}
+
 /* Find task with earliest deadline */
-static int find_earliest_deadline_task(void) {
+static RAMFUNC int find_earliest_deadline_task(void) {
     uint8_t earliest_task = 0xFF;
-    uint32_t earliest_deadline = 0xFFFFFFFF;
+    uint8_t no_deadline_task = 0xFF;
 
     for (uint8_t i = 0; i < num_tasks; i++) {
-        if (tasks[i].state != TASK_BLOCKED && tasks[i].deadline <= earliest_deadline) {
-            earliest_deadline = tasks[i].deadline;
+        if (tasks[i].state != TASK_READY && tasks[i].state != TASK_RUNNING) {
+            continue;
+        }
+        if (tasks[i].deadline_period == TASK_NO_DEADLINE) {
+            /* Only run tasks without deadline when nothing else is ready */
+            no_deadline_task = i;
+        }
+        else if (crit_mode == TASK_CRIT_HI && tasks[i].criticality == TASK_CRIT_LO) {
+            /* LO jobs are held back in HI mode */
+            continue;
+        }
+        else if (earliest_task == 0xFF || time_before(scheduling_deadline(i), scheduling_deadline(earliest_task))
+                || (scheduling_deadline(i) == scheduling_deadline(earliest_task) && earliest_task != current_task_id)) {
+            /* Ties go to the running task, an equal deadline is no reason to preempt */
             earliest_task = i;
         }
     }
 
-    return earliest_task;
+    return (earliest_task != 0xFF) ? earliest_task : no_deadline_task;
+}
+
+/* Ticks a task has been running, including the current time slice */
+uint32_t task_get_run_time(uint8_t task_id) {
+    uint32_t run_time = tasks[task_id].run_time;
+    if (task_id == current_task_id) {
+        run_time += get_tick() - dispatch_time;
+    }
+    return run_time;
+}
+
+uint8_t get_idle_task_id(void) {
+    return idle_task_id;
+}
+
+uint8_t task_get_current_id(void) {
+    return current_task_id;
 }
 
-/* Function to switch context between tasks */
-static void context_switch(void) {
+/* Switch context between tasks, R4-R11 of the running task are already on its stack */
+/* Returns the stack pointer of the task to run, its R4-R11 are restored by PendSV_Handler */
+static RAMFUNC uint32_t *context_switch(uint32_t *stack_ptr) {
+    uint32_t now = get_tick();
+
     /* Save current task's context if a task is running */
     if (current_task_id != 0xFF) {
-        __asm volatile (
-            "MRS R0, PSP\n"           /* Get current PSP value */
-            "STMDB R0!, {R4-R11}\n"   /* Save R4-R11 to stack */
-            "MSR PSP, R0\n"           /* Update PSP */
-        );
-
         /* Store current stack pointer */
-        tasks[current_task_id].stack_ptr = (uint32_t *)__get_PSP();
+        tasks[current_task_id].stack_ptr = stack_ptr;
+
+        /* Account the time slice that just ended */
+        tasks[current_task_id].run_time += now - dispatch_time;
+        tasks[current_task_id].job_run_time += now - dispatch_time;
+
+        if (tasks[current_task_id].state == TASK_RUNNING) {
+            tasks[current_task_id].state = TASK_READY;
+        }
+
+        if (tasks[current_task_id].abort_pending) {
+            tasks[current_task_id].abort_pending = false;
+            init_stack_frame(&tasks[current_task_id]);
+        }
     }
 
     uint8_t prev_task_id = current_task_id;
-    if (tasks[prev_task_id].state != TASK_BLOCKED) {
-        tasks[prev_task_id].state = TASK_READY;
-    }
 
     /* Choose next task with EDF algorithm */
-    schedule_next_task();
+    schedule_next_task(now);
 
     /* If no ready task found, use idle task */
     if (current_task_id == 0xFF) {
         /* Handle idle state */
-        return;
+        return stack_ptr;
+    }
+
+    if (prev_task_id != current_task_id) {
+        if (prev_task_id != 0xFF) {
+            tasks[prev_task_id].npr_active = false;
+        }
+        trace_record(TRACE_SWITCH, current_task_id, prev_task_id);
     }
 
     /* Update current task state to running */
     tasks[current_task_id].state = TASK_RUNNING;
+    dispatch_time = now;
+
+    /* Get a tick when a HI job exhausts its optimistic budget */
+    if (crit_mode == TASK_CRIT_LO && tasks[current_task_id].criticality == TASK_CRIT_HI
+            && tasks[current_task_id].job_run_time < tasks[current_task_id].execution_time) {
+        request_tick_at(now + tasks[current_task_id].execution_time - tasks[current_task_id].job_run_time);
+    }
 
     if (!first_context_switch) {
         /* Don't output this during first context switch */
         if (current_task_id != prev_task_id) {
-            printf("\r\n========= task %s swapped out for task %s at ticks %u =========\r\n",
+            LOG_DEBUG("\r\n========= task %s swapped out for task %s at ticks %u =========\r\n",
                     tasks[prev_task_id].name,
                     tasks[current_task_id].name,
-                    system_ticks
+                    get_tick()
             );
         }
 
-        DEBUG_LOG("\r\n");
+        LOG_TRACE("\r\n");
         for (uint8_t i = 0; i < num_tasks; i++) {
-            DEBUG_LOG("*** %s state is %s ***\r\n", tasks[i].name, get_task_state_str(i));
+            LOG_TRACE("*** %s state is %s ***\r\n", tasks[i].name, task_get_state_str(i));
         }
-        DEBUG_LOG("### Schedule task: %s ###\r\n", tasks[current_task_id].name);
-        DEBUG_LOG("\t- ticks until deadline %u\r\n", tasks[current_task_id].deadline - system_ticks);
-        DEBUG_LOG("\r\n");
+        LOG_TRACE("### Schedule task: %s ###\r\n", tasks[current_task_id].name);
+        LOG_TRACE("\t- ticks until deadline %u\r\n", tasks[current_task_id].deadline - get_tick());
+        LOG_TRACE("\r\n");
     }
     else {
         /* Reset first context switch flag */
         first_context_switch = false;
     }
 
-    /* Set PSP to the new task's stack pointer */
-    __set_PSP((uint32_t)tasks[current_task_id].stack_ptr);
+#ifdef ENABLE_STACK_GUARD
+    stack_guard_set(tasks[current_task_id].stack_base);
+#endif /* ENABLE_STACK_GUARD */
 
-    /* Restore context of the new task */
-    __asm volatile (
-        "MRS R0, PSP\n"           /* Get current PSP value */
-        "LDMIA R0!, {R4-R11}\n"   /* Restore R4-R11 from stack */
-        "MSR PSP, R0\n"           /* Update PSP */
-    );
+    return tasks[current_task_id].stack_ptr;
 }
 
 /* Schedule the next task using EDF */
-void schedule_next_task(void) {
+static RAMFUNC void schedule_next_task(uint32_t now) {
     /* Find task with earliest deadline */
     uint8_t next_task = find_earliest_deadline_task();
 
+    /* Nothing but the idle task is left in HI mode, go back to LO mode */
+    if (crit_mode == TASK_CRIT_HI && next_task == idle_task_id) {
+        switch_to_lo_mode(now);
+        next_task = find_earliest_deadline_task();
+    }
+
+    /* Limited preemption: a preempted job keeps the CPU until its non-preemptive region ends */
+    uint8_t prev = current_task_id;
+    if (prev != 0xFF && next_task != prev && tasks[prev].state == TASK_READY
+            && tasks[prev].npr_length > 0 && !tasks[prev].abort_pending
+            && !(crit_mode == TASK_CRIT_HI && tasks[prev].criticality == TASK_CRIT_LO)) {
+        if (!tasks[prev].npr_active) {
+            /* The region starts with the first deferred preemption */
+            tasks[prev].npr_active = true;
+            tasks[prev].npr_end = now + tasks[prev].npr_length;
+        }
+        if (time_before(now, tasks[prev].npr_end)) {
+            request_tick_at(tasks[prev].npr_end);
+            next_task = prev;
+        }
+    }
+
     /* Update current task ID */
     current_task_id = next_task;
 }
 
-/* Increment tick counter */
-static void tick_callback_handler(void) {
-    system_ticks++;
+/* Release jobs and check deadlines, then request the next tick interrupt */
+/* The next tick comes at the earliest release, deadline, budget or region end, PendSV only when something changed */
+static RAMFUNC void tick_callback_handler(void) {
+#ifdef ENABLE_LATENCY_STATS
+    latency_tick_enter();
+#endif /* ENABLE_LATENCY_STATS */
+    uint32_t now = get_tick();
+    /* Nothing due: wake up after one tick interval at the latest */
+    uint32_t next_event = now + TIMER2_TICK_INTERVAL;
+    bool reschedule = false;
+
+    cpu_load_update(now);
+
+    /* Budget overrun of the running HI job, otherwise the tick when it runs out */
+    if (crit_mode == TASK_CRIT_LO && current_task_id != 0xFF
+            && tasks[current_task_id].criticality == TASK_CRIT_HI) {
+        uint32_t budget_end = dispatch_time + tasks[current_task_id].execution_time - tasks[current_task_id].job_run_time;
+        if (tasks[current_task_id].job_run_time >= tasks[current_task_id].execution_time
+                || time_after_eq(now, budget_end)) {
+            switch_to_hi_mode(now);
+            reschedule = true;
+        }
+        else if (time_before(budget_end, next_event)) {
+            next_event = budget_end;
+        }
+    }
+
+    /* End of a non-preemptive region that holds back an earlier deadline */
+    if (current_task_id != 0xFF && tasks[current_task_id].npr_active) {
+        if (time_after_eq(now, tasks[current_task_id].npr_end)) {
+            reschedule = true;
+        }
+        else if (time_before(tasks[current_task_id].npr_end, next_event)) {
+            next_event = tasks[current_task_id].npr_end;
+        }
+    }
+
+    /* Deadline misses, only the passed deadlines at the head of the queue are looked at */
+    deadline_queue_flush();
+    uint8_t task_id = deadline_head;
+    while (task_id != 0xFF && time_after_eq(now, tasks[task_id].deadline)) {
+        uint8_t next_id = deadline_next[task_id];
+        if (tasks[task_id].state == TASK_WAITING || !task_has_demand(task_id)) {
+            /* No pending job, back in the queue on task_wake() or task_resume() */
+            deadline_queue_remove(task_id);
+        }
+        else if (!(crit_mode == TASK_CRIT_HI && tasks[task_id].criticality == TASK_CRIT_LO)) {
+            /* Jobs held back in HI mode are not misses */
+            handle_deadline_miss(task_id, now);
+            reschedule = true;
+        }
+        task_id = next_id;
+    }
 
     /* Check for tasks that need to be activated (when period is reached) */
     for (uint8_t i = 0; i < num_tasks; i++) {
-        if (tasks[i].deadline != 0xFFFFFFFF && system_ticks >= tasks[i].deadline) {
-            /* If task cannot achieve deadline, assert */
-            printf("\r\n!!!!! Task %s cannot meet deadline of %d ticks !!!!!\r\n",
-                    tasks[i].name,
-                    tasks[i].deadline);
-            assert_param(false);
+        if (tasks[i].state == TASK_BLOCKED) {
+            if (time_after_eq(now, tasks[i].wake_time)) {
+                tasks[i].state = TASK_READY;
+                trace_record(TRACE_RELEASE, i, 0);
+                reschedule = true;
+            }
+            else if (time_before(tasks[i].wake_time, next_event)) {
+                next_event = tasks[i].wake_time;
+            }
         }
-        if (tasks[i].wait_time > 0) {
-            tasks[i].wait_time = tasks[i].wait_time - 1;
+    }
+
+    uint32_t load_event = cpu_load_next_update();
+    if (time_before(load_event, next_event)) {
+        next_event = load_event;
+    }
+
+    /* Other interrupts may wake tasks meanwhile, their deadlines must not be overwritten */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    deadline_queue_flush();
+    /* Next deadline still ahead, held back LO jobs stay at the head with passed deadlines */
+    for (task_id = deadline_head; task_id != 0xFF; task_id = deadline_next[task_id]) {
+        if (time_before(now, tasks[task_id].deadline)) {
+            if (time_before(tasks[task_id].deadline, next_event)) {
+                next_event = tasks[task_id].deadline;
+            }
+            break;
         }
-        if (tasks[i].wait_time == 0) {
-            tasks[i].state = TASK_READY;
+    }
+    timer2_set_next_event(next_event);
+    __set_PRIMASK(primask);
+
+    /* Only switch when a job was released, missed its deadline or the mode changed */
+    if (reschedule) {
+        request_context_switch();
+    }
+#ifdef ENABLE_LATENCY_STATS
+    latency_tick_exit();
+#endif /* ENABLE_LATENCY_STATS */
+}
+
+/* Earliest time a blocked task becomes ready, returns false if no task is waiting on time */
+static bool get_next_wake_time(uint32_t *wake_time) {
+    bool found = false;
+
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        if (tasks[i].state == TASK_BLOCKED && (!found || time_before(tasks[i].wake_time, *wake_time))) {
+            *wake_time = tasks[i].wake_time;
+            found = true;
         }
     }
 
-    /* Trigger context switch */
-    SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;
+    return found;
 }
 
 /* Idle task - runs when no other tasks are ready */
 static void idle_task_func(void) {
-    /* Low power mode could be entered here */
     while(1) {
-        /* Simulate work with delay */
-        for (volatile uint32_t i = 0; i < 100000; i++);
+        uint32_t wake_time = 0;
+
+        /* Interrupts stay masked until the sleep is entered, so a release
+           cannot slip in between reading the wake time and going to sleep */
         __disable_irq();
-        SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;
+        bool has_wake_time = get_next_wake_time(&wake_time);
+        power_idle(has_wake_time, wake_time);
         __enable_irq();
+
+#ifdef ENABLE_CPU_LOAD_REPORT
+        /* Print the load report in idle time, so it never delays a job */
+        if (cpu_load_report_pending()) {
+            cpu_load_report();
+        }
+#endif /* ENABLE_CPU_LOAD_REPORT */
     }
 }
 
-static const char* get_task_state_str(uint8_t task_id) {
+/* Name of the task state, for logs and the console */
+const char *task_get_state_str(uint8_t task_id) {
     if (tasks[task_id].state == TASK_BLOCKED) {
         return "BLOCKED";
     }
+    else if (tasks[task_id].state == TASK_WAITING) {
+        return "WAITING";
+    }
+    else if (tasks[task_id].state == TASK_SUSPENDED) {
+        return "SUSPENDED";
+    }
+    else if (tasks[task_id].state == TASK_FREE) {
+        return "FREE";
+    }
     else if (tasks[task_id].state == TASK_READY) {
         return "READY";
     }
@@ -217,24 +925,245 @@ static const char* get_task_state_str(uint8_t task_id) {
     return NULL;
 }
 
+/* True if the task puts periodic demand on the CPU */
+static bool task_has_demand(uint8_t task_id) {
+    return tasks[task_id].state != TASK_FREE && tasks[task_id].state != TASK_SUSPENDED
+            && tasks[task_id].deadline_period != TASK_NO_DEADLINE;
+}
+
+/* Density sums in parts per million */
+#define DENSITY_SCALE 1000000ULL
+
+typedef struct {
+    uint64_t lo;       /* Density of LO tasks */
+    uint64_t hi_lo;    /* Density of HI tasks with their optimistic budget */
+    uint64_t hi_hi;    /* Density of HI tasks with their pessimistic WCET */
+} density_t;
+
+/* C / d rounded up like the compile-time check in task_table.h, so the test stays sufficient */
+static uint64_t density_of(uint32_t execution_time, uint32_t d) {
+    return ((uint64_t)execution_time * DENSITY_SCALE + d - 1) / d;
+}
+
+static void density_add(density_t *u, uint32_t period, uint32_t deadline_period, uint32_t execution_time,
+                        uint32_t execution_time_hi, uint32_t criticality) {
+    uint32_t d = (deadline_period < period) ? deadline_period : period;
+    if (criticality == TASK_CRIT_HI) {
+        u->hi_lo += density_of(execution_time, d);
+        u->hi_hi += density_of(execution_time_hi ? execution_time_hi : execution_time, d);
+    }
+    else {
+        u->lo += density_of(execution_time, d);
+    }
+}
+
+static density_t density_get(void) {
+    density_t u = { 0, 0, 0 };
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        if (task_has_demand(i)) {
+            density_add(&u, tasks[i].period, tasks[i].deadline_period, tasks[i].execution_time,
+                        tasks[i].execution_time_hi, tasks[i].criticality);
+        }
+    }
+    return u;
+}
+
+/* EDF-VD deadline scaling x = U_HI(LO) / (1 - U_LO(LO)) */
+static uint64_t edf_vd_scale(const density_t *u) {
+    uint64_t x = (u->lo < DENSITY_SCALE) ? u->hi_lo * DENSITY_SCALE / (DENSITY_SCALE - u->lo) : DENSITY_SCALE;
+    return (x > DENSITY_SCALE) ? DENSITY_SCALE : x;
+}
+
+/* Density test with optimistic budgets, plus the EDF-VD test x * U_LO(LO) + U_HI(HI) <= 1 with HI tasks */
+static bool density_schedulable(const density_t *u) {
+    if (u->lo + u->hi_lo > DENSITY_SCALE) {
+        return false;
+    }
+    return u->hi_hi == 0 || edf_vd_scale(u) * u->lo / DENSITY_SCALE + u->hi_hi <= DENSITY_SCALE;
+}
+
+/* Would the task set stay schedulable with this task added? Includes the TBS server */
+static bool admission_test(const task_config_t *config) {
+    density_t u = density_get();
+    if (config->deadline_period != TASK_NO_DEADLINE) {
+        density_add(&u, config->period, config->deadline_period, config->execution_time,
+                    config->execution_time_hi, config->criticality);
+    }
+    return density_schedulable(&u) && npr_schedulable(config, false);
+}
+
+/* Scale the deadlines of HI tasks for LO mode (EDF-VD), again after every change of the task set */
+static void edf_vd_update(bool verbose) {
+    density_t u = density_get();
+
+    if (u.hi_hi == 0) {
+        /* No HI task, plain EDF */
+        return;
+    }
+
+    uint64_t x = edf_vd_scale(&u);
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        if (tasks[i].criticality == TASK_CRIT_HI && tasks[i].deadline_period != TASK_NO_DEADLINE) {
+            tasks[i].virtual_deadline_period = (uint32_t)(tasks[i].deadline_period * x / DENSITY_SCALE);
+        }
+    }
+
+    if (verbose) {
+        LOG_INFO("\r\n*** EDF-VD: deadline scaling x = %u/1000 ***\r\n", (uint32_t)(x / 1000));
+        if (!density_schedulable(&u)) {
+            LOG_ERROR("!!!!! Mixed-criticality task set fails the EDF-VD test !!!!!\r\n");
+        }
+    }
+}
+
+static uint64_t gcd_u64(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+/* Timing parameters of one task for the limited-preemption test */
+typedef struct {
+    uint32_t period;
+    uint32_t deadline_period;
+    uint32_t execution_time;
+    uint32_t npr_length;
+} npr_task_t;
+
+/* Processor demand test of limited-preemption EDF: for every absolute deadline L up to
+   hyperperiod + max D, the demand of jobs with deadline <= L plus the longest non-preemptive
+   region of a task with a relative deadline beyond L must fit in L */
+/* Tests the current task set plus config if not NULL, only sets with a non-preemptive region are walked */
+static bool npr_schedulable(const task_config_t *config, bool verbose) {
+    npr_task_t set[MAX_TASKS + 1];
+    uint8_t n = 0;
+    uint64_t hyperperiod = 1;
+    uint32_t max_deadline = 0;
+    bool has_npr = false;
+
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        if (task_has_demand(i)) {
+            set[n++] = (npr_task_t){ tasks[i].period, tasks[i].deadline_period,
+                                     tasks[i].execution_time, tasks[i].npr_length };
+        }
+    }
+    if (config != NULL && config->deadline_period != TASK_NO_DEADLINE) {
+        set[n++] = (npr_task_t){ config->period, config->deadline_period,
+                                 config->execution_time, config->npr_length };
+    }
+
+    for (uint8_t i = 0; i < n; i++) {
+        hyperperiod = hyperperiod / gcd_u64(hyperperiod, set[i].period) * set[i].period;
+        if (set[i].deadline_period > max_deadline) {
+            max_deadline = set[i].deadline_period;
+        }
+        if (set[i].npr_length > 0) {
+            has_npr = true;
+        }
+    }
+
+    if (!has_npr) {
+        return true;
+    }
+    if (hyperperiod + max_deadline > 0x7FFFFFFF) {
+        if (verbose) {
+            LOG_WARN("\r\n!!!!! Hyperperiod too long, limited-preemption test skipped !!!!!\r\n");
+        }
+        return true;
+    }
+    uint32_t bound = (uint32_t)hyperperiod + max_deadline;
+
+    for (uint8_t k = 0; k < n; k++) {
+        /* Check points: the absolute deadlines of task k */
+        for (uint32_t l = set[k].deadline_period; l <= bound; l += set[k].period) {
+            uint64_t demand = 0;
+            uint32_t blocking = 0;
+            for (uint8_t i = 0; i < n; i++) {
+                if (set[i].deadline_period <= l) {
+                    demand += (uint64_t)((l - set[i].deadline_period) / set[i].period + 1) * set[i].execution_time;
+                }
+                else if (set[i].npr_length > blocking) {
+                    blocking = set[i].npr_length;
+                }
+            }
+            if (demand + blocking > l) {
+                if (verbose) {
+                    LOG_ERROR("\r\n!!!!! Non-preemptive regions break EDF schedulability at %u ticks !!!!!\r\n", l);
+                }
+                return false;
+            }
+            if (set[k].period > bound - l) {
+                break;
+            }
+        }
+    }
+    return true;
+}
+
 /* Start the scheduler */
 void start_scheduler(void) {
     /* Set up idle task */
-    create_task(idle_task_func, 0xFFFFFFFF, 0, 0xFFFFFFFF, "IdleTask");
+    task_config_t idle_config = {
+        .task_func = idle_task_func,
+        .name = "IdleTask",
+        .period = TASK_NO_DEADLINE,
+        .execution_time = 0,
+        .deadline_period = TASK_NO_DEADLINE,
+        .stack = idle_task_stack,
+        .stack_size = IDLE_STACK_SIZE,
+    };
+    idle_task_id = create_task_static(&idle_config);
+
+    edf_vd_update(true);
+    /* Blocking by non-preemptive regions is not covered by the density test, refuse to start */
+    if (!npr_schedulable(NULL, true)) {
+        assert_param(false);
+    }
+
+    /* What EDF orders the periodic tasks by, Tools/edf_golden.py rebuilds the schedule from it */
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        if (i != idle_task_id && tasks[i].state == TASK_READY) {
+            LOG_INFO("*** Schedule %s: offset %u, deadline %u, virtual deadline %u, npr %u, criticality %s ***\r\n",
+                    tasks[i].name, tasks[i].offset, tasks[i].deadline_period,
+                    (tasks[i].criticality == TASK_CRIT_HI) ? tasks[i].virtual_deadline_period : tasks[i].deadline_period,
+                    tasks[i].npr_length, (tasks[i].criticality == TASK_CRIT_HI) ? "HI" : "LO");
+        }
+    }
+
+    /* Offsets count from here, so every task sees the same time origin */
+    uint32_t start_time = get_tick();
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        if (tasks[i].state != TASK_WAITING && tasks[i].state != TASK_SUSPENDED && tasks[i].state != TASK_FREE) {
+            release_first_job(i, start_time);
+        }
+    }
+    scheduler_started = true;
+
+    LOG_INFO("\r\n################### EDF Scheduler Started at ticks %u ###################\r\n", start_time);
 
-    printf("\r\n########################## EDF Scheduler Started ##########################\r\n");
+#ifdef ENABLE_STACK_GUARD
+    stack_guard_init();
+#endif /* ENABLE_STACK_GUARD */
+#ifdef ENABLE_LATENCY_STATS
+    latency_init();
+#endif /* ENABLE_LATENCY_STATS */
 
     /* Set up tick interrupt callback */
     timer2_set_tick_callback(tick_callback_handler);
 
-    /* Configure system to use Process Stack for exceptions handlers */
+    /* Configure system to use Process Stack for exceptions handlers, until the
+       first switch it points to the main stack, the first PendSV saves to it */
+    __set_PSP(__get_MSP());
     __set_CONTROL(__get_CONTROL() | 0x02);
 
     /* Start with no current task */
     current_task_id = 0xFF;
 
     /* Force context switch to start first task */
-    SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;
+    request_context_switch();
 
     /* Enable interrupts */
     __enable_irq();
@@ -243,16 +1172,48 @@ void start_scheduler(void) {
     while(1);
 }
 
-/**
-  * @brief This function handles Pendable request for system service.
-  */
-void PendSV_Handler(void) {
-    /* Disable interrupts */
-    __disable_irq();
+/* C part of PendSV_Handler, takes and returns the task stack pointer below the saved registers */
+RAMFUNC uint32_t * __attribute__((used)) pendsv_context_switch(uint32_t *stack_ptr) {
+    trace_isr_enter();
 
     /* Perform context switch */
-    context_switch();
+    stack_ptr = context_switch(stack_ptr);
 
-    /* Enable interrupts */
-    __enable_irq();
+#ifdef ENABLE_LATENCY_STATS
+    latency_switch_done();
+#endif /* ENABLE_LATENCY_STATS */
+    trace_isr_exit();
+
+    return stack_ptr;
+}
+
+/**
+  * @brief This function handles Pendable request for system service.
+  * R4-R11 are saved and restored here, before and after any compiled code
+  * runs, so the switch does not depend on how the compiler allocates registers.
+  * Every task keeps its EXC_RETURN on its stack, with the FPU in use (hard
+  * float) bit 4 tells whether the task has FPU state and S16-S31 are saved
+  * with it, S0-S15 are stacked lazily by the hardware.
+  */
+RAMFUNC void __attribute__((naked)) PendSV_Handler(void) {
+    __asm volatile (
+        "CPSID I\n"               /* Disable interrupts */
+        "MRS R0, PSP\n"           /* Get current PSP value */
+#if (__FPU_USED == 1U)
+        "TST LR, #0x10\n"         /* EXC_RETURN bit 4: 0 = FPU state in use */
+        "IT EQ\n"
+        "VSTMDBEQ R0!, {S16-S31}\n"
+#endif
+        "STMDB R0!, {R4-R11, LR}\n"   /* Save R4-R11 and EXC_RETURN to stack */
+        "BL pendsv_context_switch\n"
+        "LDMIA R0!, {R4-R11, LR}\n"   /* Restore R4-R11 and EXC_RETURN of the new task */
+#if (__FPU_USED == 1U)
+        "TST LR, #0x10\n"
+        "IT EQ\n"
+        "VLDMIAEQ R0!, {S16-S31}\n"
+#endif
+        "MSR PSP, R0\n"           /* Update PSP */
+        "CPSIE I\n"               /* Enable interrupts */
+        "BX LR\n"
+    );
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "main.h"
+#include "tbs.h"
+
+/* Pending aperiodic job */
+typedef struct {
+    void (*job_func)(void *);
+    void *arg;
+    uint32_t deadline;        /* Absolute deadline assigned on submission */
+} tbs_job_t;
+
+static tbs_job_t queue[TBS_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0;    /* Next job to run */
+static volatile uint8_t queue_count = 0;
+
+static uint32_t last_deadline = 0;         /* Deadline given to the previous job */
+static uint8_t server_id = 0xFF;
+
+static uint32_t server_stack[TBS_STACK_SIZE] __attribute__((aligned(TASK_STACK_ALIGN)));
+
+/* Server task, runs queued jobs in order, deadlines are non-decreasing along the queue */
+static void tbs_server_func(void) {
+    while (1) {
+        __disable_irq();
+        if (queue_count == 0) {
+            /* Woken up by tbs_submit() with the deadline of the new job */
+            task_wait();
+            __enable_irq();
+            continue;
+        }
+        tbs_job_t job = queue[queue_head];
+        __enable_irq();
+
+        job.job_func(job.arg);
+
+        __disable_irq();
+        queue_head = (queue_head + 1) % TBS_QUEUE_SIZE;
+        queue_count--;
+        if (queue_count > 0) {
+            /* Continue with the deadline of the next job */
+            task_set_deadline(server_id, queue[queue_head].deadline);
+        }
+        __enable_irq();
+    }
+}
+
+/* Create the server task, call before start_scheduler() */
+void tbs_init(void) {
+    task_config_t config = {
+        .task_func = tbs_server_func,
+        .name = "TBSServer",
+        /* Declared as a task using TBS_BANDWIDTH of a 1 s period */
+        .period = MS_TO_TICKS(1000),
+        .execution_time = (uint32_t)((uint64_t)MS_TO_TICKS(1000) * TBS_BANDWIDTH / TBS_BANDWIDTH_SCALE),
+        .deadline_period = MS_TO_TICKS(1000),
+        /* A late job still has to finish, the queue holds on to it */
+        .miss_policy = TASK_MISS_CONTINUE,
+        .stack = server_stack,
+        .stack_size = TBS_STACK_SIZE,
+    };
+
+    server_id = create_task_static(&config);
+    assert_param(server_id != 0xFF);
+
+    /* Nothing to serve yet */
+    tasks[server_id].state = TASK_WAITING;
+}
+
+/* Queue an aperiodic job with the given worst-case execution time (in ticks), safe from interrupts */
+/* Returns false if the queue is full */
+bool tbs_submit(void (*job_func)(void *), void *arg, uint32_t execution_time) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (queue_count >= TBS_QUEUE_SIZE) {
+        __set_PRIMASK(primask);
+        return false;
+    }
+
+    /* d = max(r, d_prev) + C / Us */
+    uint32_t now = get_tick();
+    uint32_t start = time_before(now, last_deadline) ? last_deadline : now;
+    uint32_t deadline = start + (uint32_t)((uint64_t)execution_time * TBS_BANDWIDTH_SCALE / TBS_BANDWIDTH);
+
+    tbs_job_t *job = &queue[(queue_head + queue_count) % TBS_QUEUE_SIZE];
+    job->job_func = job_func;
+    job->arg = arg;
+    job->deadline = deadline;
+    queue_count++;
+    last_deadline = deadline;
+
+    if (tasks[server_id].state == TASK_WAITING) {
+        task_wake(server_id, deadline);
+    }
+
+    __set_PRIMASK(primask);
+    return true;
+}
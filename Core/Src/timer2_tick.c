@@ -1,28 +1,74 @@
 #include "main.h"
 #include "timer2_tick.h"
+#include "trace.h"
+#include "ramfunc.h"
 #include <stdbool.h>
 
 static TIM_HandleTypeDef htim2;
 static void (*tick_cb_)(void);
 
+/* Counter ticks per HAL millisecond */
+#define TIMER2_COUNTS_PER_MS (TIMER2_COUNTER_HZ / 1000)
+
+/* HAL millisecond time, advanced from the counter on every tick interrupt */
+static volatile uint32_t ms_base;    /* Milliseconds at cnt_base */
+static volatile uint32_t cnt_base;   /* Counter value at the last millisecond boundary */
+
+/* TIM2 input clock, twice PCLK1 when APB1 is divided */
+static uint32_t timer2_get_clock(void) {
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) == RCC_HCLK_DIV1) {
+        return HAL_RCC_GetPCLK1Freq();
+    }
+    return 2U * HAL_RCC_GetPCLK1Freq();
+}
+
 void timer2_tick_init(void) {
-    /* Initialized tick interrupt at 1ms interval */
-    uint32_t uwPrescalerValue = (uint32_t)((SystemCoreClock /2) / 1000000) - 1;
+    /* TIM2 is a 32-bit timer, let it run freely at TIMER2_COUNTER_HZ and
+       raise the tick interrupt with channel 1 compare events */
+    uint32_t uwPrescalerValue = (timer2_get_clock() / TIMER2_COUNTER_HZ) - 1;
+    TIM_OC_InitTypeDef sConfig = {0};
+
+    if (htim2.State != HAL_TIM_STATE_RESET) {
+        /* Already running, only follow a system clock change. The update event
+           loads the new prescaler but also clears the counter, put it back so
+           the absolute release, deadline and wake times stay valid */
+        if (TIM2->PSC != uwPrescalerValue) {
+            uint32_t primask = __get_PRIMASK();
+            __disable_irq();
+            uint32_t cnt = TIM2->CNT;
+            __HAL_TIM_SET_PRESCALER(&htim2, uwPrescalerValue);
+            TIM2->EGR = TIM_EGR_UG;
+            TIM2->CNT = cnt;
+            /* The pending compare may have been skipped over */
+            timer2_set_next_event(timer2_get_next_event());
+            __set_PRIMASK(primask);
+        }
+        return;
+    }
 
     htim2.Instance = TIM2;
-    htim2.Init.Period = 1000 - 1;
+    htim2.Init.Period = 0xFFFFFFFF;
     htim2.Init.Prescaler = uwPrescalerValue;
     htim2.Init.ClockDivision = 0;
     htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
     htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
-    if (HAL_TIM_Base_Init(&htim2) != HAL_OK) {
+    if (HAL_TIM_OC_Init(&htim2) != HAL_OK) {
         /* Initialization Error */
         assert_param(false);
     }
 
-    /* Start the TIM Base generation in interrupt mode */
-    /* Start Channel1 */
-    if (HAL_TIM_Base_Start_IT(&htim2) != HAL_OK) {
+    /* First tick interrupt after one tick interval */
+    sConfig.OCMode = TIM_OCMODE_TIMING;
+    sConfig.Pulse = TIMER2_TICK_INTERVAL;
+    sConfig.OCPolarity = TIM_OCPOLARITY_HIGH;
+    sConfig.OCFastMode = TIM_OCFAST_DISABLE;
+    if (HAL_TIM_OC_ConfigChannel(&htim2, &sConfig, TIM_CHANNEL_1) != HAL_OK) {
+        /* Configuration Error */
+        assert_param(false);
+    }
+
+    /* Start the counter with Channel1 compare interrupt */
+    if (HAL_TIM_OC_Start_IT(&htim2, TIM_CHANNEL_1) != HAL_OK) {
         /* Starting Error */
         assert_param(false);
     }
@@ -32,25 +78,100 @@ void timer2_set_tick_callback(void (*tick_cb)(void)) {
     tick_cb_ = tick_cb;
 }
 
-void HAL_TIM_Base_MspInit(TIM_HandleTypeDef *htim) {
+/* Free running counter, wraps around after 2^32 counter ticks */
+RAMFUNC uint32_t timer2_get_counter(void) {
+    return TIM2->CNT;
+}
+
+/* Request the next tick interrupt at the given counter value */
+RAMFUNC void timer2_set_next_event(uint32_t counter) {
+    __HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_1, counter);
+
+    /* If the counter already passed the compare value the match would only
+       happen after a full wrap, so generate the event by software instead */
+    if ((int32_t)(counter - TIM2->CNT) <= 0) {
+        TIM2->EGR = TIM_EGR_CC1G;
+    }
+}
+
+/* Counter value of the pending tick interrupt */
+RAMFUNC uint32_t timer2_get_next_event(void) {
+    return __HAL_TIM_GET_COMPARE(&htim2, TIM_CHANNEL_1);
+}
+
+/* Move the counter forward, for time spent with TIM2 halted (STOP mode) */
+void timer2_advance(uint32_t counts) {
+    TIM2->CNT += counts;
+
+    /* The pending compare may have been skipped over */
+    timer2_set_next_event(timer2_get_next_event());
+}
+
+void HAL_TIM_OC_MspInit(TIM_HandleTypeDef *htim) {
     /* Enable peripherals and GPIO Clocks */
     /* TIMx Peripheral clock enable */
     __HAL_RCC_TIM2_CLK_ENABLE();
 
     /* Configure the NVIC for TIMx */
     /* Set Interrupt Group Priority */
-    /* HAL_NVIC_SetPriority(TIMx_IRQn, 4, 0); */
-    HAL_NVIC_SetPriority(TIM2_IRQn, 4, 0);
+    HAL_NVIC_SetPriority(TIM2_IRQn, TICK_INT_PRIORITY, 0);
 
     /* Enable the TIMx global Interrupt */
     HAL_NVIC_EnableIRQ(TIM2_IRQn);
 }
 
-void TIM2_IRQHandler(void) {
+RAMFUNC void TIM2_IRQHandler(void) {
+    trace_isr_enter();
     HAL_TIM_IRQHandler(&htim2);
+    trace_isr_exit();
 }
 
-void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
-    /* Call tick handler function */
+RAMFUNC void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef *htim) {
+    /* Advance HAL time by the milliseconds elapsed since the previous tick */
+    uint32_t elapsed_ms = (TIM2->CNT - cnt_base) / TIMER2_COUNTS_PER_MS;
+    ms_base += elapsed_ms;
+    cnt_base += elapsed_ms * TIMER2_COUNTS_PER_MS;
+
+    /* Call tick handler function, it is in charge of requesting the next event */
     if (tick_cb_) tick_cb_();
-}
\ No newline at end of file
+    else timer2_set_next_event(timer2_get_counter() + TIMER2_TICK_INTERVAL);
+}
+
+/*
+ * HAL time base on TIM2.
+ * These override the SysTick based weak implementations in stm32f4xx_hal.c,
+ * so HAL_GetTick()/HAL_Delay() and the scheduler share one clock and SysTick stays off.
+ */
+
+/* Called by HAL_Init() and again by HAL_RCC_ClockConfig() after a clock change */
+HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority) {
+    if (TickPriority >= (1UL << __NVIC_PRIO_BITS)) {
+        return HAL_ERROR;
+    }
+    uwTickPrio = TickPriority;
+
+    timer2_tick_init();
+    HAL_NVIC_SetPriority(TIM2_IRQn, TickPriority, 0);
+
+    return HAL_OK;
+}
+
+/* Milliseconds since boot, derived from the TIM2 counter so it also advances with interrupts disabled */
+uint32_t HAL_GetTick(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t ms = ms_base + (TIM2->CNT - cnt_base) / TIMER2_COUNTS_PER_MS;
+    __set_PRIMASK(primask);
+
+    return ms;
+}
+
+void HAL_SuspendTick(void) {
+    /* Disable TIM2 compare interrupt, the counter keeps running */
+    __HAL_TIM_DISABLE_IT(&htim2, TIM_IT_CC1);
+}
+
+void HAL_ResumeTick(void) {
+    /* Enable TIM2 compare interrupt */
+    __HAL_TIM_ENABLE_IT(&htim2, TIM_IT_CC1);
+}
@@ -0,0 +1,139 @@
+#include "main.h"
+#include "task.h"
+#include "trace.h"
+#include "ramfunc.h"
+#include <stdbool.h>
+
+static trace_event_t ring[TRACE_SIZE];
+static uint32_t trace_count = 0;    /* Events recorded since boot, wraps around */
+
+#ifdef ENABLE_TRACE_STREAM
+static UART_HandleTypeDef huart2;
+static bool stream_ready = false;
+
+/* Bytes waiting for USART2, sent from its TXE interrupt */
+static uint8_t stream_buffer[TRACE_STREAM_BUFFER];
+static volatile uint32_t stream_head = 0;    /* Written by trace_record() */
+static volatile uint32_t stream_tail = 0;    /* Written by the USART2 interrupt */
+static uint32_t stream_dropped = 0;
+
+/* Queue an event for sending, called with interrupts disabled */
+/* Events that do not fit are dropped whole, so the stream stays aligned to events */
+static RAMFUNC void trace_stream_write(const trace_event_t *event) {
+    if (TRACE_STREAM_BUFFER - (stream_head - stream_tail) < sizeof(*event)) {
+        stream_dropped++;
+        return;
+    }
+
+    const uint8_t *bytes = (const uint8_t *)event;
+    for (uint32_t i = 0; i < sizeof(*event); i++) {
+        stream_buffer[(stream_head + i) & (TRACE_STREAM_BUFFER - 1)] = bytes[i];
+    }
+    stream_head += sizeof(*event);
+    USART2->CR1 |= USART_CR1_TXEIE;
+}
+
+/* Not traced itself, its own events would keep the stream busy */
+void USART2_IRQHandler(void) {
+    if ((USART2->SR & USART_SR_TXE) && (USART2->CR1 & USART_CR1_TXEIE)) {
+        if (stream_tail != stream_head) {
+            USART2->DR = stream_buffer[stream_tail & (TRACE_STREAM_BUFFER - 1)];
+            stream_tail++;
+        }
+        else {
+            USART2->CR1 &= ~USART_CR1_TXEIE;
+        }
+    }
+}
+#endif /* ENABLE_TRACE_STREAM */
+
+_Static_assert(sizeof(trace_event_t) == 8, "the trace stream format is 8 bytes per event");
+
+/* Append an event, safe from interrupts */
+RAMFUNC void trace_record(uint8_t type, uint8_t task_id, uint16_t arg) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    trace_event_t *event = &ring[trace_count & (TRACE_SIZE - 1)];
+    event->time = get_tick();
+    event->type = type;
+    event->task_id = task_id;
+    event->arg = arg;
+    trace_count++;
+
+#ifdef ENABLE_TRACE_STREAM
+    if (stream_ready) {
+        trace_stream_write(event);
+    }
+#endif /* ENABLE_TRACE_STREAM */
+
+    __set_PRIMASK(primask);
+}
+
+/* Copy up to max_events of the latest events, oldest first, returns the number copied */
+uint32_t trace_snapshot(trace_event_t *events, uint32_t max_events) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t n = (trace_count < TRACE_SIZE) ? trace_count : TRACE_SIZE;
+    if (n > max_events) {
+        n = max_events;
+    }
+    uint32_t first = trace_count - n;
+    for (uint32_t i = 0; i < n; i++) {
+        events[i] = ring[(first + i) & (TRACE_SIZE - 1)];
+    }
+
+    __set_PRIMASK(primask);
+    return n;
+}
+
+const char *trace_type_str(uint8_t type) {
+    switch (type) {
+    case TRACE_SWITCH:
+        return "SWITCH";
+    case TRACE_RELEASE:
+        return "RELEASE";
+    case TRACE_COMPLETE:
+        return "COMPLETE";
+    case TRACE_MISS:
+        return "MISS";
+    case TRACE_MODE:
+        return "MODE";
+    case TRACE_IRQ_ENTER:
+        return "IRQ_ENTER";
+    case TRACE_IRQ_EXIT:
+        return "IRQ_EXIT";
+    default:
+        return "?";
+    }
+}
+
+/* Start sending events over USART2, does nothing without ENABLE_TRACE_STREAM */
+void trace_stream_init(void) {
+#ifdef ENABLE_TRACE_STREAM
+    huart2.Instance = USART2;
+    huart2.Init.BaudRate = TRACE_STREAM_BAUD;
+    huart2.Init.WordLength = UART_WORDLENGTH_8B;
+    huart2.Init.StopBits = UART_STOPBITS_1;
+    huart2.Init.Parity = UART_PARITY_NONE;
+    huart2.Init.Mode = UART_MODE_TX;
+    huart2.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    huart2.Init.OverSampling = UART_OVERSAMPLING_16;
+    if (HAL_UART_Init(&huart2) != HAL_OK) {
+        return;
+    }
+    HAL_NVIC_SetPriority(USART2_IRQn, TRACE_STREAM_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(USART2_IRQn);
+    stream_ready = true;
+#endif /* ENABLE_TRACE_STREAM */
+}
+
+/* Events the stream had no room for since boot */
+uint32_t trace_stream_dropped(void) {
+#ifdef ENABLE_TRACE_STREAM
+    return stream_dropped;
+#else
+    return 0;
+#endif /* ENABLE_TRACE_STREAM */
+}
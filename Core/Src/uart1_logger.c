@@ -1,7 +1,9 @@
 #include "main.h"
 #include "uart1_logger.h"
+#include "trace.h"
 
 static UART_HandleTypeDef huart1;
+static void (*rx_callback)(uint8_t byte) = NULL;
 
 void uart1_logger_init(void) {
     huart1.Instance = USART1;
@@ -17,6 +19,35 @@ void uart1_logger_init(void) {
     }
 }
 
+/* Send raw bytes, blocking */
+void uart1_logger_write(const uint8_t *data, uint32_t len) {
+    HAL_UART_Transmit(&huart1, (uint8_t *)data, (uint16_t)len, 0xFFFF);
+}
+
+/* Call callback from the USART1 interrupt for every received byte */
+void uart1_logger_set_rx_callback(void (*callback)(uint8_t byte)) {
+    rx_callback = callback;
+
+    /* Reception runs on the RXNE interrupt alone, transmission stays polled */
+    __HAL_UART_ENABLE_IT(&huart1, UART_IT_RXNE);
+    HAL_NVIC_SetPriority(USART1_IRQn, UART1_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(USART1_IRQn);
+}
+
+void USART1_IRQHandler(void) {
+    trace_isr_enter();
+    uint32_t sr = USART1->SR;
+
+    if (sr & (USART_SR_RXNE | USART_SR_ORE)) {
+        /* Reading DR after SR also clears an overrun */
+        uint8_t byte = (uint8_t)USART1->DR;
+        if ((sr & USART_SR_RXNE) && rx_callback != NULL) {
+            rx_callback(byte);
+        }
+    }
+    trace_isr_exit();
+}
+
 /**
 * @brief UART MSP Initialization
 * This function configures the hardware resources used in this example
@@ -43,6 +74,21 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart)
         GPIO_InitStruct.Alternate = GPIO_AF7_USART1;
         HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
     }
+    else if (huart->Instance == USART2) {
+        /* Trace stream, see trace.h */
+        __HAL_RCC_USART2_CLK_ENABLE();
+
+        __HAL_RCC_GPIOA_CLK_ENABLE();
+        /**USART2 GPIO Configuration
+        PA2     ------> USART2_TX
+        */
+        GPIO_InitStruct.Pin = GPIO_PIN_2;
+        GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+        GPIO_InitStruct.Pull = GPIO_NOPULL;
+        GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+        GPIO_InitStruct.Alternate = GPIO_AF7_USART2;
+        HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+    }
 }
 
 /**
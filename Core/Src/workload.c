@@ -0,0 +1,48 @@
+#include "main.h"
+#include "workload.h"
+#include "timer2_tick.h"
+
+/* Loop iterations timed during calibration */
+#define WORKLOAD_CALIBRATION_LOOPS 100000
+
+/* Burn loop iterations per millisecond, measured by workload_calibrate() */
+static uint32_t loops_per_ms = 0;
+
+/* Two instruction loop, its duration only depends on the core clock and flash settings */
+static void burn_loops(uint32_t loops) {
+    if (loops == 0) {
+        return;
+    }
+
+    __asm volatile (
+        "1: SUBS %0, %0, #1\n"
+        "   BNE 1b\n"
+        : "+r" (loops)
+        :
+        : "cc"
+    );
+}
+
+/* Time the burn loop against TIM2, call with interrupts disabled after the clock is configured */
+void workload_calibrate(void) {
+    uint32_t start = timer2_get_counter();
+    burn_loops(WORKLOAD_CALIBRATION_LOOPS);
+    uint32_t elapsed = timer2_get_counter() - start;
+
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    loops_per_ms = (uint32_t)((uint64_t)WORKLOAD_CALIBRATION_LOOPS * (TIMER2_COUNTER_HZ / 1000) / elapsed);
+}
+
+/* Burn approximately the given number of CPU cycles */
+void workload_burn_cycles(uint32_t cycles) {
+    assert_param(loops_per_ms != 0);
+    burn_loops((uint32_t)((uint64_t)cycles * loops_per_ms / (SystemCoreClock / 1000)));
+}
+
+/* Burn approximately the given number of microseconds of CPU time */
+void workload_burn_us(uint32_t us) {
+    assert_param(loops_per_ms != 0);
+    burn_loops((uint32_t)((uint64_t)us * loops_per_ms / 1000));
+}
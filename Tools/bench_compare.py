@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Print and compare the results of the benchmark firmware.
+
+Reads the "BENCH," lines of one or more USART1 logs of the benchmark
+firmware (make bench, Renode/run_bench.resc) and prints the average cycles
+of every benchmark side by side. The first log is the baseline, the other
+columns show the change against it. Logs of different MAX_TASKS builds
+compare the same way, the header shows the task count of each run.
+
+With --threshold the exit status is 1 if any average grew by more than
+the given percentage over the baseline.
+
+  Tools/bench_compare.py build/bench.log
+  Tools/bench_compare.py base.log new.log --threshold 5
+"""
+
+import argparse
+import sys
+
+COLUMNS = ("name", "tasks", "samples", "min", "avg", "max")
+
+
+class Run:
+    def __init__(self, path, label=None):
+        self.path = path
+        self.label = label
+        self.core_hz = None
+        self.max_tasks = None
+        self.results = {}
+        self.done = False
+
+        with open(path, "r", errors="replace") as f:
+            for line in f:
+                fields = line.strip().split(",")
+                if fields[0] != "BENCH" or len(fields) < 2:
+                    continue
+                if fields[1] == "start" and len(fields) == 4:
+                    self.core_hz, self.max_tasks = int(fields[2]), int(fields[3])
+                elif fields[1] == "done":
+                    self.done = True
+                elif fields[1] != "name" and len(fields) == 1 + len(COLUMNS):
+                    values = dict(zip(COLUMNS, [fields[1]] + [int(v) for v in fields[2:]]))
+                    self.results[values["name"]] = values
+        if self.label is None:
+            self.label = f"MAX_TASKS {self.max_tasks}"
+
+
+def compare(runs, threshold=None):
+    """Print the averages of the runs side by side, returns the regressions over threshold percent"""
+    names = []
+    for run in runs:
+        names += [name for name in run.results if name not in names]
+
+    header = f"{'avg cycles':<16}" + "".join(f"{run.label:>24}" for run in runs)
+    print(header)
+    print("-" * len(header))
+
+    regressions = []
+    base = runs[0]
+    for name in names:
+        row = f"{name:<16}"
+        for run in runs:
+            result = run.results.get(name)
+            if result is None:
+                row += f"{'-':>24}"
+                continue
+            cell = f"{result['avg']}"
+            base_result = base.results.get(name)
+            if run is not base and base_result and base_result["avg"] > 0:
+                change = 100.0 * (result["avg"] - base_result["avg"]) / base_result["avg"]
+                cell += f" ({change:+.1f}%)"
+                if threshold is not None and change > threshold:
+                    regressions.append(f"{name}: {base_result['avg']} -> {result['avg']} cycles in {run.path}")
+            row += f"{cell:>24}"
+        print(row)
+
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("logs", nargs="+", help="USART1 logs of the benchmark firmware, the first is the baseline")
+    parser.add_argument("--threshold", type=float, help="fail if an average grew by more than this percentage")
+    args = parser.parse_args()
+
+    runs = [Run(path) for path in args.logs]
+    for run in runs:
+        if not run.results:
+            sys.exit(f"{run.path}: no benchmark results")
+        if not run.done:
+            print(f"warning: {run.path}: results incomplete, the run ended before BENCH,done", file=sys.stderr)
+
+    regressions = compare(runs, args.threshold)
+    for regression in regressions:
+        print(f"regression: {regression}")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,386 @@
+#!/usr/bin/env python3
+"""Check a scheduler log against a reference EDF schedule.
+
+The task parameters are read from the log ("Create task" banners and the
+"Schedule" lines printed by start_scheduler()), the reference schedule is
+simulated from them and compared with the observed one:
+
+  - every dispatch (job start, preemption, resumption, switch to idle) in order,
+  - optionally its time, within --tolerance ticks,
+  - the deadline misses.
+
+The first divergence is reported with the events leading up to it and the
+exit status is 1, 0 if the schedules agree.
+
+Execution times vary from job to job, so the reference does not use the
+declared WCET: each simulated job runs exactly as long as the same job ran
+in the log, only jobs still unfinished when the log ends (e.g. halted by a
+deadline miss) are given their declared execution time. The comparison therefore checks the scheduling decisions, not the
+workload. The simulation follows the kernel: EDF on absolute deadlines, HI
+tasks on virtual deadlines in LO criticality mode, ties to the running task
+and then to the higher task id, non-preemptive regions starting with the first
+deferred preemption, and job releases one period after the previous one.
+Only periodic tasks are modeled, check builds without ENABLE_TBS and
+ENABLE_CONSOLE.
+
+The log comes from a run under Renode, see Renode/capture_log.resc, or from
+the board. "make golden" builds and checks every scenario of main.c.
+
+  Tools/edf_golden.py build/uart.log
+  Tools/edf_golden.py --renode build/stm32f407Disc_EDF_Demo.elf --time 00:00:02
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from edf_trace import RE_CREATE, RE_PARAM, RE_SWITCH, RE_STARTED, RE_FINISHED, RE_MISS, IDLE_NAMES  # noqa: E402
+
+RE_SCHEDULE = re.compile(r"\*\*\* Schedule (\S+): offset (\d+), deadline (\d+), virtual deadline (\d+), "
+                         r"npr (\d+), criticality (LO|HI) \*\*\*")
+RE_STARTED_AT = re.compile(r"EDF Scheduler Started(?: at ticks (\d+))?")
+
+NO_DEADLINE = 0xFFFFFFFF
+
+
+class Task:
+    def __init__(self, name, index):
+        self.name = name
+        self.index = index
+        self.period = None
+        self.execution_time = None
+        self.deadline = None
+        self.virtual_deadline = None
+        self.offset = 0
+        self.npr = 0
+        self.hi = False
+        self.created_at = 0
+        self.demands = []           # Observed execution time of each job
+
+    @property
+    def periodic(self):
+        return self.period is not None and self.period != NO_DEADLINE
+
+
+class Log:
+    """Task set and observed schedule of one run"""
+
+    def __init__(self):
+        self.tasks = {}
+        self.start = None
+        self.dispatches = []        # (time, task name)
+        self.misses = []            # (time, task name)
+        self.end = 0
+
+    def task(self, name):
+        if name not in self.tasks:
+            self.tasks[name] = Task(name, len(self.tasks))
+        return self.tasks[name]
+
+
+def read_log(stream):
+    log = Log()
+    creating = None
+    running = None
+    slice_start = None
+    job_run = {}                    # Run time of the active job of each task
+    finishing = set()               # Job printed "finished" but has not switched out yet
+
+    def run(until):
+        nonlocal slice_start
+        if running is not None and slice_start is not None and running in job_run:
+            job_run[running] += until - slice_start
+        slice_start = until
+
+    def complete(name):
+        log.tasks[name].demands.append(job_run.pop(name))
+        finishing.discard(name)
+
+    for line in stream:
+        m = RE_PARAM.match(line)
+        if m and creating is not None:
+            key, value = m.group(1), int(m.group(2))
+            task = log.tasks[creating]
+            if key == "Current ticks":
+                task.created_at = value
+            elif key == "offset":
+                task.offset = value
+            elif key == "period":
+                task.period = value
+            elif key == "xc time":
+                task.execution_time = value
+            elif key == "deadline at":
+                task.deadline = value
+            continue
+        if creating is not None:
+            task = log.tasks[creating]
+            if task.deadline is not None and task.periodic:
+                # "deadline at" is absolute
+                task.deadline -= task.created_at + task.offset
+                task.virtual_deadline = task.deadline
+            creating = None
+
+        m = RE_CREATE.search(line)
+        if m:
+            creating = m.group(1)
+            log.task(creating)
+            continue
+        m = RE_SCHEDULE.search(line)
+        if m:
+            task = log.task(m.group(1))
+            task.offset, task.deadline, task.virtual_deadline, task.npr = (int(g) for g in m.group(2, 3, 4, 5))
+            task.hi = m.group(6) == "HI"
+            continue
+        m = RE_STARTED_AT.search(line)
+        if m:
+            if m.group(1) is not None:
+                log.start = int(m.group(1))
+            continue
+        m = RE_SWITCH.search(line)
+        if m:
+            time = int(m.group(3))
+            run(time)
+            prev, running = m.group(1), m.group(2)
+            if prev in finishing:
+                complete(prev)
+            log.dispatches.append((time, running))
+            log.end = time
+            continue
+        m = RE_STARTED.search(line)
+        if m:
+            name, time = m.group(1), int(m.group(2))
+            if running is None:
+                # The first switch of the scheduler is not logged
+                running = name
+                slice_start = time
+                log.dispatches.append((time, name))
+            run(time)
+            if name in finishing:
+                complete(name)
+            job_run[name] = 0
+            log.end = time
+            continue
+        m = RE_FINISHED.search(line)
+        if m:
+            name, time = m.group(1), int(m.group(2))
+            run(time)
+            if name in job_run:
+                finishing.add(name)
+            log.end = time
+            continue
+        m = RE_MISS.search(line)
+        if m:
+            time = int(m.group(2))
+            log.misses.append((time, m.group(1)))
+            log.end = max(log.end, time)
+
+    if log.start is None:
+        # Logs of older firmware: jobs are released from the time the tasks were created
+        log.start = min((t.created_at for t in log.tasks.values() if t.periodic), default=0)
+    return log
+
+
+class Job:
+    def __init__(self, release, deadline, sched_deadline, demand):
+        self.release = release
+        self.deadline = deadline
+        self.sched_deadline = sched_deadline
+        self.remaining = demand
+        self.run = 0
+        self.npr_active = False
+        self.npr_end = None
+
+
+def simulate(log, stop_on_miss):
+    """Reference EDF schedule, returns (dispatches, misses, horizon)"""
+    tasks = sorted((t for t in log.tasks.values() if t.periodic), key=lambda t: t.index)
+    idle = next((t.name for t in log.tasks.values() if t.name in IDLE_NAMES), "IdleTask")
+    for task in tasks:
+        if task.deadline is None:
+            sys.exit(f"no deadline known for task {task.name}")
+
+    next_release = {t.name: log.start + t.offset for t in tasks}
+    job_index = {t.name: 0 for t in tasks}
+    jobs = {}
+    hi_mode = False
+    running = None
+    now = log.start
+    dispatches = []
+    misses = []
+    missed = set()
+
+    # Jobs that did not complete before the log ended run for their declared execution time
+    horizon = log.end
+    for task in tasks:
+        if task.execution_time is None:
+            sys.exit(f"no execution time known for task {task.name}")
+
+    def sched_deadline(task, job):
+        return job.sched_deadline if (task.hi and not hi_mode) else job.deadline
+
+    while now < horizon:
+        # Releases
+        for task in tasks:
+            if task.name not in jobs and now >= next_release[task.name]:
+                release = next_release[task.name]
+                k = job_index[task.name]
+                demand = task.demands[k] if k < len(task.demands) else task.execution_time
+                jobs[task.name] = Job(release, release + task.deadline, release + task.virtual_deadline, demand)
+                job_index[task.name] = k + 1
+
+        # Deadline misses, LO jobs held back in HI mode do not count
+        for task in tasks:
+            job = jobs.get(task.name)
+            if job and now >= job.deadline and (task.name, job.release) not in missed \
+                    and not (hi_mode and not task.hi):
+                missed.add((task.name, job.release))
+                misses.append((now, task.name))
+                if stop_on_miss:
+                    return dispatches, misses, now
+
+        # EDF with ties to the running task, then to the higher task id (the later one in tasks)
+        def pick():
+            best = None
+            for task in tasks:
+                job = jobs.get(task.name)
+                if job is None or (hi_mode and not task.hi):
+                    continue
+                if best is None or sched_deadline(task, job) < sched_deadline(*best) \
+                        or (sched_deadline(task, job) == sched_deadline(*best) and best[0].name != running):
+                    best = (task, job)
+            return best[0].name if best else idle
+
+        choice = pick()
+        if hi_mode and choice == idle:
+            hi_mode = False
+            for task in tasks:
+                job = jobs.get(task.name)
+                if not task.hi and job and now >= job.deadline:
+                    job.release = now
+                    job.deadline = now + task.deadline
+            choice = pick()
+
+        # Limited preemption
+        prev_job = jobs.get(running)
+        npr_until = None
+        if prev_job and choice != running:
+            prev = log.tasks[running]
+            if prev.npr > 0 and not (hi_mode and not prev.hi):
+                if not prev_job.npr_active:
+                    prev_job.npr_active = True
+                    prev_job.npr_end = now + prev.npr
+                if now < prev_job.npr_end:
+                    choice = running
+                    npr_until = prev_job.npr_end
+
+        if choice != running:
+            dispatches.append((now, choice))
+            running = choice
+
+        # Next event
+        events = [horizon]
+        events += [next_release[t.name] for t in tasks if t.name not in jobs]
+        events += [j.deadline for n, j in jobs.items() if (n, j.release) not in missed and j.deadline > now]
+        if npr_until is not None:
+            events.append(npr_until)
+        job = jobs.get(running)
+        if job:
+            events.append(now + job.remaining)
+            task = log.tasks[running]
+            if task.hi and not hi_mode and task.execution_time is not None and job.run < task.execution_time:
+                events.append(now + task.execution_time - job.run)
+        step = max(min(events) - now, 0)
+        if step == 0 and job is None and not npr_until:
+            step = 1
+
+        now += step
+        if job is None:
+            continue
+        job.remaining -= step
+        job.run += step
+        task = log.tasks[running]
+        if job.remaining <= 0:
+            # task_yield(): the next job is released one period after this one
+            del jobs[running]
+            next_release[running] = job.release + task.period
+        elif task.hi and not hi_mode and task.execution_time is not None and job.run >= task.execution_time:
+            # Budget overrun of a HI job
+            hi_mode = True
+
+    return dispatches, misses, horizon
+
+
+def compare(name, expected, observed, horizon, tolerance, context):
+    observed = [e for e in observed if e[0] < horizon]
+    expected = [e for e in expected if e[0] < horizon]
+    for i in range(max(len(expected), len(observed))):
+        exp = expected[i] if i < len(expected) else None
+        obs = observed[i] if i < len(observed) else None
+        if exp is not None and obs is not None and exp[1] == obs[1] \
+                and (tolerance is None or abs(exp[0] - obs[0]) <= tolerance):
+            continue
+        print(f"{name}: first divergence at event {i}")
+        for j in range(max(0, i - context), i):
+            print(f"    {expected[j][0]:>10} {expected[j][1]}")
+        print(f"  expected: {f'{exp[1]} at {exp[0]}' if exp else 'nothing'}")
+        print(f"  observed: {f'{obs[1]} at {obs[0]}' if obs else 'nothing'}")
+        return False
+    return True
+
+
+def capture(elf, time):
+    """Run the firmware under Renode and return its UART output"""
+    renode_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Renode")
+    with tempfile.TemporaryDirectory() as tmp:
+        log_path = os.path.join(tmp, "uart.log")
+        commands = (f"$bin=@{os.path.abspath(elf)}; $log=@{log_path}; $time=\"{time}\"; "
+                    f"include @{os.path.join(renode_dir, 'capture_log.resc')}")
+        subprocess.run(["renode", "--disable-xwt", "--console", "-e", commands],
+                       check=True, cwd=os.path.join(renode_dir, ".."), stdout=subprocess.DEVNULL)
+        with open(log_path, errors="replace") as f:
+            return f.read().splitlines(keepends=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check a scheduler log against a reference EDF schedule.")
+    parser.add_argument("log", nargs="?", help="UART log of the run (default: stdin)")
+    parser.add_argument("--renode", metavar="ELF", help="capture the log by running ELF under Renode")
+    parser.add_argument("--time", default="00:00:02", help="emulated time of the Renode run")
+    parser.add_argument("--tolerance", type=int, help="also compare event times, within this many ticks")
+    parser.add_argument("--continue-on-miss", action="store_true",
+                        help="tasks keep running after a miss (TASK_MISS_CONTINUE) instead of halting")
+    parser.add_argument("--context", type=int, default=5, help="events shown before a divergence")
+    args = parser.parse_args()
+
+    if args.renode:
+        name = args.renode
+        log = read_log(capture(args.renode, args.time))
+    elif args.log:
+        name = args.log
+        with open(args.log, errors="replace") as f:
+            log = read_log(f)
+    else:
+        name = "stdin"
+        log = read_log(sys.stdin)
+
+    if not log.dispatches:
+        sys.exit(f"{name}: no scheduling events in the log")
+
+    expected, expected_misses, horizon = simulate(log, not args.continue_on_miss)
+
+    ok = compare(name, expected, log.dispatches, horizon, args.tolerance, args.context)
+    if ok:
+        ok = compare(f"{name} (deadline misses)", expected_misses, log.misses, horizon + 1,
+                     args.tolerance, args.context)
+    if ok:
+        print(f"{name}: {len([e for e in expected if e[0] < horizon])} dispatches and "
+              f"{len(expected_misses)} deadline misses match up to tick {horizon}")
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""Pick release offsets (phases) for a periodic task set.
+
+Offsets are searched so that job releases are spread over the hyperperiod
+instead of all coinciding at its start. For each candidate assignment the
+tool replays the releases of one steady-state hyperperiod and scores it by
+
+  1. the peak backlog (work released but not yet executed, any scheduler
+     that never idles while work is pending has the same backlog), then
+  2. the largest amount of work released at a single instant.
+
+The search is a greedy assignment, largest execution time first, followed
+by passes of single-task improvements until nothing changes.
+
+Tasks are given as NAME:PERIOD:EXEC[:DEADLINE] in milliseconds, e.g.
+
+  Tools/edf_offsets.py Task1:40:10 Task2:40:5:30 Task3:30:5:15
+
+The result is printed as the offset column of the EDF_TASK_TABLE entries.
+"""
+
+import argparse
+import math
+import sys
+from fractions import Fraction
+
+
+class Task:
+    def __init__(self, spec):
+        parts = spec.split(":")
+        if len(parts) not in (3, 4):
+            raise argparse.ArgumentTypeError(f"bad task '{spec}', expected NAME:PERIOD:EXEC[:DEADLINE]")
+        try:
+            values = [Fraction(p) for p in parts[1:]]
+        except ValueError:
+            raise argparse.ArgumentTypeError(f"bad number in task '{spec}'")
+        self.name = parts[0]
+        self.period = values[0]
+        self.execution_time = values[1]
+        self.deadline = values[2] if len(values) == 3 else self.period
+        self.offset = Fraction(0)
+        if self.period <= 0 or self.execution_time <= 0 or self.deadline <= 0:
+            raise argparse.ArgumentTypeError(f"times of task '{spec}' must be positive")
+
+
+def lcm(values):
+    """Least common multiple of positive fractions: lcm of numerators over gcd of denominators."""
+    num = 1
+    for v in values:
+        num = num * v.numerator // math.gcd(num, v.numerator)
+    return Fraction(num, math.gcd(*[v.denominator for v in values]))
+
+
+def score(tasks, hyperperiod):
+    """(peak backlog, peak simultaneous release) over a steady-state hyperperiod."""
+    # From the last first release on, the release pattern repeats every hyperperiod
+    start = max(t.offset for t in tasks)
+    end = start + hyperperiod
+
+    # Work released at each instant of one hyperperiod
+    releases = {}
+    for t in tasks:
+        time = t.offset + math.ceil((start - t.offset) / t.period) * t.period
+        while time < end:
+            releases[time] = releases.get(time, 0) + t.execution_time
+            time += t.period
+    instants = sorted(releases)
+
+    backlog = Fraction(0)
+    last = start
+    peak_backlog = Fraction(0)
+    # The first lap only carries the backlog over into the measured second one
+    for lap in range(2):
+        for time in instants:
+            shifted = time + lap * hyperperiod
+            backlog = max(Fraction(0), backlog - (shifted - last))
+            last = shifted
+            backlog += releases[time]
+            if lap == 1:
+                peak_backlog = max(peak_backlog, backlog)
+    return (peak_backlog, max(releases.values()))
+
+
+def candidates(task, resolution):
+    steps = int(task.period / resolution)
+    return [resolution * i for i in range(steps)]
+
+
+def optimize(tasks, hyperperiod, resolution, passes):
+    order = sorted(tasks, key=lambda t: t.execution_time, reverse=True)
+
+    # Greedy: place tasks one by one against the ones already placed
+    placed = []
+    for task in order:
+        placed.append(task)
+        if len(placed) == 1:
+            task.offset = Fraction(0)
+            continue
+        best = None
+        for offset in candidates(task, resolution):
+            task.offset = offset
+            s = score(placed, hyperperiod)
+            if best is None or s < best[0]:
+                best = (s, offset)
+        task.offset = best[1]
+
+    # Local search: move one task at a time while it helps
+    current = score(tasks, hyperperiod)
+    for _ in range(passes):
+        improved = False
+        for task in order[1:]:
+            keep = task.offset
+            for offset in candidates(task, resolution):
+                task.offset = offset
+                s = score(tasks, hyperperiod)
+                if s < current:
+                    current = s
+                    keep = offset
+                    improved = True
+            task.offset = keep
+        if not improved:
+            break
+    return current
+
+
+def fmt(value):
+    return str(value.numerator) if value.denominator == 1 else f"{float(value):g}"
+
+
+def ticks_macro(ms):
+    """Offset as kernel macro, MS_TO_TICKS() truncates its argument so fractions go to US_TO_TICKS()"""
+    if ms.denominator == 1:
+        return f"MS_TO_TICKS({ms.numerator})"
+    return f"US_TO_TICKS({round(ms * 1000)})"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("tasks", nargs="+", type=Task, help="NAME:PERIOD:EXEC[:DEADLINE] in milliseconds")
+    parser.add_argument("--resolution", type=Fraction, default=Fraction(1),
+                        help="offset granularity in milliseconds (default 1)")
+    parser.add_argument("--passes", type=int, default=10, help="maximum local search passes (default 10)")
+    args = parser.parse_args()
+
+    tasks = args.tasks
+    hyperperiod = lcm([t.period for t in tasks])
+    utilization = sum(t.execution_time / t.period for t in tasks)
+    if utilization > 1:
+        print(f"warning: utilization {float(utilization):.3f} exceeds 1, backlog grows without bound",
+              file=sys.stderr)
+
+    synchronous = score(tasks, hyperperiod)
+    result = optimize(tasks, hyperperiod, args.resolution, args.passes)
+
+    print(f"hyperperiod {fmt(hyperperiod)} ms, utilization {float(utilization):.3f}")
+    print(f"synchronous release: peak backlog {fmt(synchronous[0])} ms, peak burst {fmt(synchronous[1])} ms")
+    print(f"with offsets:        peak backlog {fmt(result[0])} ms, peak burst {fmt(result[1])} ms")
+    print()
+    for t in tasks:
+        print(f"    {t.name}: offset {ticks_macro(t.offset)}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,506 @@
+#!/usr/bin/env python3
+"""Turn scheduler logs and traces into per-task statistics and timelines.
+
+Two inputs are understood:
+
+  text    the UART log of the firmware (decode ENABLE_DEFERRED_LOG output with
+          Tools/log_decode.py first). Task parameters come from the
+          "Create task" banners, execution from the swap and started/finished
+          lines, deadline misses from the "cannot meet deadline" lines.
+  binary  trace_event_t records of trace.h (8 bytes each, little endian:
+          time u32, type u8, task id u8, arg u16), e.g. the trace ring saved
+          with "dump binary memory" from GDB or the ENABLE_TRACE_STREAM output
+          captured with Renode/trace_capture.resc. Task names are given with
+          --names, deadlines with --task. With ENABLE_TRACE_ISR the handler
+          entries and exits (TIM2, PendSV, USART1) go to an "Interrupts"
+          track and their durations into the report.
+
+Text logs have no release events, a job is taken to be released at the
+latest multiple of the period (plus offset) before it started, which holds
+while response times stay below the period. Binary traces carry the releases.
+
+The input is read as a stream and only per-task aggregates are kept, so logs
+of millions of events fit in constant memory. Per task the tool reports jobs,
+response time (finish - release), lateness (finish - absolute deadline, the
+negative of the slack), execution time, preemptions and utilization.
+
+Timelines are written as Chrome trace JSON (chrome://tracing, ui.perfetto.dev),
+streamed like the input, or as an SVG Gantt chart of the first --svg-limit
+execution slices.
+
+  Tools/edf_trace.py demo_logs/normal/run_normal_edf.txt --tick-us 1000 --chrome normal.json
+  Tools/edf_trace.py trace.bin --binary --names Task1,Task2,Task3,IdleTask --svg trace.svg
+"""
+
+import argparse
+import json
+import re
+import struct
+import sys
+
+# Event types of trace.h
+TRACE_SWITCH = 1
+TRACE_RELEASE = 2
+TRACE_COMPLETE = 3
+TRACE_MISS = 4
+TRACE_MODE = 5
+TRACE_IRQ_ENTER = 6
+TRACE_IRQ_EXIT = 7
+
+# Exception numbers (IPSR) of the traced handlers, external interrupts are IRQn + 16
+EXCEPTION_NAMES = {14: "PendSV", 15: "SysTick", 16 + 28: "TIM2", 16 + 37: "USART1", 16 + 3: "RTC_WKUP"}
+
+IDLE_NAMES = ("IdleTask",)
+
+
+class Params:
+    """Timing parameters of a task, in ticks"""
+
+    def __init__(self, period=None, execution_time=None, deadline=None, offset=0):
+        self.period = period
+        self.execution_time = execution_time
+        self.deadline = deadline
+        self.offset = offset
+
+
+def parse_task_spec(spec):
+    parts = spec.split(":")
+    if len(parts) not in (4, 5):
+        raise argparse.ArgumentTypeError(f"bad task '{spec}', expected NAME:PERIOD:EXEC:DEADLINE[:OFFSET]")
+    try:
+        values = [int(p) for p in parts[1:]]
+    except ValueError:
+        raise argparse.ArgumentTypeError(f"bad number in task '{spec}'")
+    return parts[0], Params(*values)
+
+
+class Stat:
+    """Running min/avg/max"""
+
+    def __init__(self):
+        self.count = 0
+        self.total = 0
+        self.min = None
+        self.max = None
+
+    def add(self, value):
+        self.count += 1
+        self.total += value
+        self.min = value if self.min is None else min(self.min, value)
+        self.max = value if self.max is None else max(self.max, value)
+
+    def __str__(self):
+        if not self.count:
+            return "-"
+        return f"{self.min}/{self.total / self.count:.1f}/{self.max}"
+
+
+class TaskStats:
+    def __init__(self, name, index):
+        self.name = name
+        self.index = index
+        self.params = Params()
+        self.jobs = 0
+        self.misses = 0
+        self.preemptions = 0
+        self.run_time = 0
+        self.response = Stat()
+        self.lateness = Stat()
+        self.execution = Stat()
+        # Current job
+        self.release = None
+        self.active = False
+        self.job_run_time = 0
+
+    def last_release(self, time):
+        """Latest periodic release at or before time, text logs carry no release events"""
+        p = self.params
+        if p.period is None or time < p.offset:
+            return None
+        return p.offset + (time - p.offset) // p.period * p.period
+
+
+class Analyzer:
+    """Builds jobs and execution slices from scheduler events"""
+
+    def __init__(self, sinks):
+        self.tasks = {}
+        self.sinks = sinks
+        self.running = None
+        self.slice_start = None
+        self.first_time = None
+        self.last_time = None
+        self.irqs = {}              # Handler duration per exception number
+        self.irq_entered = {}       # Entry times of the handlers being run, they nest
+
+    def task(self, name):
+        if name not in self.tasks:
+            self.tasks[name] = TaskStats(name, len(self.tasks))
+            for sink in self.sinks:
+                sink.task(self.tasks[name])
+        return self.tasks[name]
+
+    def _time(self, time):
+        if self.first_time is None:
+            self.first_time = time
+        self.last_time = time
+
+    def _close_slice(self, time):
+        if self.running is not None and self.slice_start is not None and time > self.slice_start:
+            task = self.tasks[self.running]
+            task.run_time += time - self.slice_start
+            if task.active:
+                task.job_run_time += time - self.slice_start
+            for sink in self.sinks:
+                sink.slice(task, self.slice_start, time)
+        self.slice_start = time
+
+    def switch(self, time, prev, new):
+        self._time(time)
+        self._close_slice(time)
+        if prev is not None:
+            prev_task = self.task(prev)
+            if prev_task.active:
+                prev_task.preemptions += 1
+        self.task(new)
+        self.running = new
+
+    def release(self, time, name):
+        self._time(time)
+        task = self.task(name)
+        if not task.active:
+            task.release = time
+
+    def start(self, time, name):
+        self._time(time)
+        task = self.task(name)
+        if self.running is None:
+            # The first switch of the scheduler is not logged
+            self.running = name
+            self.slice_start = time
+        if task.active or name in IDLE_NAMES:
+            return
+        if task.release is None or task.params.period is not None:
+            release = task.last_release(time)
+            if release is not None:
+                task.release = release
+        task.active = True
+        task.job_run_time = 0
+
+    def finish(self, time, name):
+        self._time(time)
+        task = self.task(name)
+        if self.running == name:
+            self._close_slice(time)
+        if not task.active:
+            return
+        task.active = False
+        task.jobs += 1
+        task.execution.add(task.job_run_time)
+        if task.release is not None:
+            task.response.add(time - task.release)
+            if task.params.deadline is not None:
+                lateness = time - (task.release + task.params.deadline)
+                task.lateness.add(lateness)
+                if lateness > 0:
+                    task.misses += 1
+            for sink in self.sinks:
+                sink.job(task, task.release, time)
+
+    def miss(self, time, name):
+        self._time(time)
+        task = self.task(name)
+        if task.params.deadline is None:
+            # Counted from the event when lateness cannot be computed
+            task.misses += 1
+        for sink in self.sinks:
+            sink.instant(task, time, "deadline miss")
+
+    def irq_enter(self, time, number):
+        self._time(time)
+        self.irq_entered.setdefault(number, []).append(time)
+        for sink in self.sinks:
+            sink.irq(time, number, True)
+
+    def irq_exit(self, time, number):
+        self._time(time)
+        entered = self.irq_entered.get(number)
+        if entered:
+            self.irqs.setdefault(number, Stat()).add(time - entered.pop())
+        for sink in self.sinks:
+            sink.irq(time, number, False)
+
+    def mode(self, time, hi):
+        self._time(time)
+        for sink in self.sinks:
+            sink.global_instant(time, "criticality mode " + ("HI" if hi else "LO"))
+
+    def end(self):
+        if self.last_time is not None:
+            self._close_slice(self.last_time)
+        for sink in self.sinks:
+            sink.close()
+
+
+# Lines of the firmware log
+RE_CREATE = re.compile(r"\*\*\* Create task: (\S+) \*\*\*")
+RE_PARAM = re.compile(r"^\s*- ([A-Za-z ]+?) (\d+)")
+RE_SWITCH = re.compile(r"task (\S+) swapped out for task (\S+) at ticks (\d+)")
+RE_STARTED = re.compile(r"(\S+) started at tick (\d+)")
+RE_FINISHED = re.compile(r"(\S+) finished at tick (\d+)")
+RE_MISS = re.compile(r"Task (\S+) cannot meet deadline of (\d+) ticks")
+
+
+def read_text(stream, analyzer, overrides):
+    creating = None
+    values = {}
+
+    def create_done():
+        if creating is None or creating in overrides:
+            return
+        created = values.get("Current ticks", 0)
+        offset = values.get("offset", 0)
+        period = values.get("period")
+        deadline_at = values.get("deadline at")
+        if period is None or period == 0xFFFFFFFF:
+            return
+        deadline = deadline_at - created - offset if deadline_at is not None else period
+        analyzer.task(creating).params = Params(period, values.get("xc time"), deadline, offset)
+
+    for line in stream:
+        m = RE_PARAM.match(line)
+        if m and creating is not None:
+            values[m.group(1)] = int(m.group(2))
+            continue
+        create_done()
+        creating = None
+
+        m = RE_CREATE.search(line)
+        if m:
+            creating = m.group(1)
+            values = {}
+            analyzer.task(creating)
+            continue
+        m = RE_SWITCH.search(line)
+        if m:
+            analyzer.switch(int(m.group(3)), m.group(1), m.group(2))
+            continue
+        m = RE_STARTED.search(line)
+        if m:
+            analyzer.start(int(m.group(2)), m.group(1))
+            continue
+        m = RE_FINISHED.search(line)
+        if m:
+            analyzer.finish(int(m.group(2)), m.group(1))
+            continue
+        m = RE_MISS.search(line)
+        if m:
+            analyzer.miss(int(m.group(2)), m.group(1))
+    create_done()
+
+
+def read_binary(stream, analyzer, names):
+    def name(task_id):
+        return names[task_id] if task_id < len(names) else f"task{task_id}"
+
+    epoch = 0
+    last = None
+    while True:
+        record = stream.read(8)
+        if len(record) < 8:
+            break
+        raw, kind, task_id, arg = struct.unpack("<IBBH", record)
+        # Unwrap the 32-bit tick counter
+        if last is not None and raw < last and last - raw > 1 << 31:
+            epoch += 1 << 32
+        last = raw
+        time = epoch + raw
+
+        if kind == TRACE_SWITCH:
+            analyzer.switch(time, name(arg) if analyzer.running is not None else None, name(task_id))
+            analyzer.start(time, name(task_id))
+        elif kind == TRACE_RELEASE:
+            analyzer.release(time, name(task_id))
+        elif kind == TRACE_COMPLETE:
+            analyzer.finish(time, name(task_id))
+        elif kind == TRACE_MISS:
+            analyzer.miss(time, name(task_id))
+        elif kind == TRACE_MODE:
+            analyzer.mode(time, arg != 0)
+        elif kind == TRACE_IRQ_ENTER:
+            analyzer.irq_enter(time, arg)
+        elif kind == TRACE_IRQ_EXIT:
+            analyzer.irq_exit(time, arg)
+
+
+class ChromeTrace:
+    """Chrome trace event JSON, written while the input is read"""
+
+    IRQ_TID = 1000
+
+    def __init__(self, path, tick_us):
+        self.out = open(path, "w")
+        self.tick_us = tick_us
+        self.first = True
+        self.first_irq = True
+        self.out.write("[\n")
+
+    def _event(self, event):
+        if not self.first:
+            self.out.write(",\n")
+        self.first = False
+        self.out.write(json.dumps(event, separators=(",", ":")))
+
+    def task(self, task):
+        self._event({"name": "thread_name", "ph": "M", "pid": 1, "tid": task.index,
+                     "args": {"name": task.name}})
+
+    def slice(self, task, start, end):
+        self._event({"name": task.name, "ph": "X", "pid": 1, "tid": task.index,
+                     "ts": start * self.tick_us, "dur": (end - start) * self.tick_us})
+
+    def job(self, task, release, finish):
+        self._event({"name": "job", "cat": "job", "ph": "X", "pid": 2, "tid": task.index,
+                     "ts": release * self.tick_us, "dur": (finish - release) * self.tick_us})
+
+    def instant(self, task, time, what):
+        self._event({"name": what, "ph": "i", "s": "t", "pid": 1, "tid": task.index,
+                     "ts": time * self.tick_us})
+
+    def irq(self, time, number, enter):
+        if self.first_irq:
+            self.first_irq = False
+            self._event({"name": "thread_name", "ph": "M", "pid": 1, "tid": self.IRQ_TID,
+                         "args": {"name": "Interrupts"}})
+        # Begin/end pairs, so nested handlers stack up in the viewer
+        self._event({"name": EXCEPTION_NAMES.get(number, f"exception {number}"), "ph": "B" if enter else "E",
+                     "pid": 1, "tid": self.IRQ_TID, "ts": time * self.tick_us})
+
+    def global_instant(self, time, what):
+        self._event({"name": what, "ph": "i", "s": "g", "pid": 1, "ts": time * self.tick_us})
+
+    def close(self):
+        self.out.write("\n]\n")
+        self.out.close()
+
+
+class SvgGantt:
+    """Gantt chart of the first limit execution slices"""
+
+    ROW = 24
+    LABEL = 90
+    WIDTH = 1200
+
+    def __init__(self, path, limit):
+        self.path = path
+        self.limit = limit
+        self.tasks = []
+        self.slices = []
+        self.misses = []
+
+    def task(self, task):
+        self.tasks.append(task)
+
+    def slice(self, task, start, end):
+        if len(self.slices) < self.limit:
+            self.slices.append((task.index, start, end))
+
+    def job(self, task, release, finish):
+        pass
+
+    def instant(self, task, time, what):
+        if len(self.slices) < self.limit:
+            self.misses.append((task.index, time))
+
+    def irq(self, time, number, enter):
+        pass
+
+    def global_instant(self, time, what):
+        pass
+
+    def close(self):
+        if not self.slices:
+            begin, end = 0, 1
+        else:
+            begin = min(s[1] for s in self.slices)
+            end = max(s[2] for s in self.slices)
+        scale = (self.WIDTH - self.LABEL) / max(end - begin, 1)
+        height = self.ROW * (len(self.tasks) + 1)
+
+        def x(time):
+            return self.LABEL + (time - begin) * scale
+
+        with open(self.path, "w") as out:
+            out.write(f'<svg xmlns="http://www.w3.org/2000/svg" width="{self.WIDTH}" height="{height}" '
+                      f'font-family="monospace" font-size="12">\n')
+            for task in self.tasks:
+                y = task.index * self.ROW
+                out.write(f'<text x="4" y="{y + 16}">{task.name}</text>\n')
+                out.write(f'<line x1="{self.LABEL}" y1="{y + self.ROW}" x2="{self.WIDTH}" y2="{y + self.ROW}" '
+                          f'stroke="#ddd"/>\n')
+            for index, start, stop in self.slices:
+                hue = index * 67 % 360
+                out.write(f'<rect x="{x(start):.2f}" y="{index * self.ROW + 4}" '
+                          f'width="{max((stop - start) * scale, 0.5):.2f}" height="{self.ROW - 8}" '
+                          f'fill="hsl({hue},60%,55%)"><title>{self.tasks[index].name} {start}-{stop}</title></rect>\n')
+            for index, time in self.misses:
+                out.write(f'<path d="M{x(time):.2f} {index * self.ROW + 2} l-4 -6 h8 z" fill="red">'
+                          f'<title>deadline miss {time}</title></path>\n')
+            y = len(self.tasks) * self.ROW + 16
+            out.write(f'<text x="{self.LABEL}" y="{y}">{begin}</text>\n')
+            out.write(f'<text x="{self.WIDTH - 4}" y="{y}" text-anchor="end">{end} ticks</text>\n')
+            out.write("</svg>\n")
+
+
+def report(analyzer, out):
+    span = (analyzer.last_time - analyzer.first_time) if analyzer.first_time is not None else 0
+    out.write(f"{span} ticks analyzed\n")
+    out.write(f"{'task':<12} {'jobs':>6} {'misses':>6} {'preempt':>7} {'util %':>7}  "
+              f"{'response min/avg/max':<24} {'lateness min/avg/max':<24} {'exec min/avg/max':<24}\n")
+    for task in analyzer.tasks.values():
+        util = 100.0 * task.run_time / span if span else 0.0
+        out.write(f"{task.name:<12} {task.jobs:>6} {task.misses:>6} {task.preemptions:>7} {util:>7.2f}  "
+                  f"{str(task.response):<24} {str(task.lateness):<24} {str(task.execution):<24}\n")
+    if analyzer.irqs:
+        out.write(f"\n{'handler':<12} {'count':>8}  {'duration min/avg/max':<24}\n")
+        for number, stat in sorted(analyzer.irqs.items()):
+            out.write(f"{EXCEPTION_NAMES.get(number, f'exception {number}'):<12} {stat.count:>8}  {str(stat):<24}\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Per-task statistics and timelines from scheduler logs and traces.")
+    parser.add_argument("input", nargs="?", help="log or trace file (default: stdin)")
+    parser.add_argument("--binary", action="store_true", help="input is trace_event_t records")
+    parser.add_argument("--names", default="", help="comma separated task names by task id, for --binary")
+    parser.add_argument("--task", action="append", default=[], type=parse_task_spec, metavar="NAME:T:C:D[:O]",
+                        help="task parameters in ticks, overrides the log")
+    parser.add_argument("--tick-us", type=float, default=1.0, help="microseconds per tick (default: 1)")
+    parser.add_argument("--chrome", help="write a Chrome trace JSON file")
+    parser.add_argument("--svg", help="write an SVG Gantt chart")
+    parser.add_argument("--svg-limit", type=int, default=2000, help="execution slices drawn in the SVG chart")
+    args = parser.parse_args()
+
+    sinks = []
+    if args.chrome:
+        sinks.append(ChromeTrace(args.chrome, args.tick_us))
+    if args.svg:
+        sinks.append(SvgGantt(args.svg, args.svg_limit))
+
+    analyzer = Analyzer(sinks)
+    overrides = dict(args.task)
+    for name, params in overrides.items():
+        analyzer.task(name).params = params
+
+    if args.binary:
+        stream = open(args.input, "rb") if args.input else sys.stdin.buffer
+        read_binary(stream, analyzer, [n for n in args.names.split(",") if n])
+    else:
+        stream = open(args.input, errors="replace") if args.input else sys.stdin
+        read_text(stream, analyzer, overrides)
+    analyzer.end()
+
+    report(analyzer, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""Decode the deferred log stream of the firmware (ENABLE_DEFERRED_LOG).
+
+DLOG() sends frames instead of text:
+
+  0xA5 | id (u16) | argument count (u8) | arguments (u32 each)
+
+all little endian. The id is the offset of the format string in the
+.log_strings section of the ELF file, which is not loaded to flash.
+%s arguments are addresses of strings in flash, they are read from the
+loaded sections of the same ELF file. Everything outside a frame is plain
+printf() output and is passed through unchanged.
+
+  Tools/log_decode.py build/simple-edf-stm32f4-renode.elf uart.bin
+  socat -u /dev/ttyUSB0,raw,b115200 - | Tools/log_decode.py build/*.elf
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+SYNC = 0xA5
+MAX_ARGS = 8
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+
+class Elf:
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+        if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+            raise ValueError(f"{path}: not a little endian ELF32 file")
+
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", data, 0x2E)
+        headers = [struct.unpack_from("<IIIIIIIIII", data, shoff + i * shentsize)
+                   for i in range(shnum)]
+        names = headers[shstrndx]
+
+        self.log_strings = None
+        self.alloc = []  # (address, bytes) of loaded sections
+        for name, sh_type, flags, addr, offset, size, *_ in headers:
+            end = data.index(b"\0", names[4] + name)
+            sec_name = data[names[4] + name:end].decode()
+            contents = b"" if sh_type == SHT_NOBITS else data[offset:offset + size]
+            if sec_name == ".log_strings":
+                self.log_strings = contents
+            elif flags & SHF_ALLOC and contents:
+                self.alloc.append((addr, contents))
+        if self.log_strings is None:
+            raise ValueError(f"{path}: no .log_strings section, build with -DENABLE_DEFERRED_LOG")
+
+    def format_string(self, msg_id):
+        if msg_id >= len(self.log_strings):
+            return None
+        end = self.log_strings.index(b"\0", msg_id)
+        return self.log_strings[msg_id:end].decode(errors="replace")
+
+    def string_at(self, addr):
+        for base, contents in self.alloc:
+            if base <= addr < base + len(contents):
+                end = contents.find(b"\0", addr - base)
+                return contents[addr - base:end].decode(errors="replace")
+        return f"<0x{addr:08x}>"
+
+
+CONVERSION = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|z|t)?([diuxXcsp%])")
+
+
+def render(elf, fmt, args):
+    """printf() for 32-bit argument words"""
+    args = iter(args)
+
+    def convert(m):
+        flags, width, precision, conv = m.groups()
+        if conv == "%":
+            return "%"
+        value = next(args, 0)
+        spec = "%" + flags + width + (f".{precision}" if precision else "")
+        if conv in "di":
+            return (spec + "d") % (value - (1 << 32) if value & 0x80000000 else value)
+        if conv == "u":
+            return (spec + "d") % value
+        if conv == "c":
+            return (spec + "c") % chr(value & 0xFF)
+        if conv == "s":
+            return (spec + "s") % elf.string_at(value)
+        if conv == "p":
+            return f"0x{value:08x}"
+        return (spec + conv) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def decode(elf, stream, out):
+    buf = b""
+    while True:
+        chunk = stream.read1(4096) if hasattr(stream, "read1") else stream.read(4096)
+        if not chunk:
+            break
+        buf += chunk
+        while buf:
+            start = buf.find(bytes([SYNC]))
+            if start < 0:
+                out.write(buf.decode(errors="replace"))
+                buf = b""
+                break
+            out.write(buf[:start].decode(errors="replace"))
+            buf = buf[start:]
+            if len(buf) < 4:
+                break
+            msg_id, nargs = struct.unpack_from("<HB", buf, 1)
+            fmt = elf.format_string(msg_id)
+            if fmt is None or nargs > MAX_ARGS:
+                # Not a frame, most likely a lost byte: skip the sync byte
+                buf = buf[1:]
+                continue
+            size = 4 + 4 * nargs
+            if len(buf) < size:
+                break
+            args = struct.unpack_from(f"<{nargs}I", buf, 4)
+            out.write(render(elf, fmt, args))
+            buf = buf[size:]
+        out.flush()
+    out.write(buf.decode(errors="replace"))
+    out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode the deferred log stream of the firmware.")
+    parser.add_argument("elf", help="firmware ELF file the stream was produced by")
+    parser.add_argument("input", nargs="?", help="captured UART bytes (default: stdin)")
+    args = parser.parse_args()
+
+    try:
+        elf = Elf(args.elf)
+    except (OSError, ValueError) as e:
+        sys.exit(str(e))
+
+    if args.input:
+        with open(args.input, "rb") as stream:
+            decode(elf, stream, sys.stdout)
+    else:
+        decode(elf, sys.stdin.buffer, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
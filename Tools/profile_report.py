@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""Compare the image size and the benchmark cycles of two or more builds.
+
+Reads the section headers and symbols of each ELF file and prints
+
+  flash     bytes loaded to flash (code, constants, initial data, hot path copy)
+  ram       statically allocated RAM (data, bss, heap and stack reservation)
+  ram code  kernel hot path run from SRAM (.RamFunc, ENABLE_RAMFUNC)
+
+side by side, the first ELF is the baseline. With --renode every ELF is run
+under Renode with Renode/run_bench.resc, it has to be a benchmark firmware
+(make bench), and the benchmark averages are compared the same way.
+"make profile-report" does this for the debug and the release profile.
+
+  Tools/profile_report.py build/bench/stm32f407Disc_EDF_Demo_bench.elf \\
+      build/release/bench/stm32f407Disc_EDF_Demo_bench.elf --renode
+"""
+
+import argparse
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from bench_compare import Run, compare  # noqa: E402
+
+SHF_ALLOC = 0x2
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+RAM_RANGES = ((0x10000000, 0x10010000), (0x20000000, 0x20020000))
+
+
+class Image:
+    def __init__(self, path):
+        self.path = path
+        with open(path, "rb") as f:
+            data = f.read()
+        if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+            raise ValueError(f"{path}: not a little endian ELF32 file")
+
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", data, 0x2E)
+        headers = [struct.unpack_from("<IIIIIIIIII", data, shoff + i * shentsize)
+                   for i in range(shnum)]
+
+        self.flash = 0
+        self.ram = 0
+        symbols = {}
+        for _, sh_type, flags, addr, offset, size, link, _, _, entsize in headers:
+            if sh_type == SHT_SYMTAB:
+                strtab = headers[link][4]
+                for i in range(size // entsize):
+                    name, value = struct.unpack_from("<II", data, offset + i * entsize)
+                    end = data.index(b"\0", strtab + name)
+                    symbols[data[strtab + name:end].decode()] = value
+            if not flags & SHF_ALLOC:
+                continue
+            if sh_type != SHT_NOBITS:
+                self.flash += size
+            if any(lo <= addr < hi for lo, hi in RAM_RANGES):
+                self.ram += size
+        self.ram_code = symbols.get("_eramfunc", 0) - symbols.get("_sramfunc", 0)
+
+
+def run_bench(elf, log):
+    renode_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Renode")
+    commands = (f"$bin=@{os.path.abspath(elf)}; $log=@{log}; "
+                f"include @{os.path.join(renode_dir, 'run_bench.resc')}")
+    subprocess.run(["renode", "--disable-xwt", "--console", "-e", commands],
+                   check=True, cwd=os.path.join(renode_dir, ".."), stdout=subprocess.DEVNULL)
+
+
+def label(path):
+    # build/release/bench/x.elf -> release/bench
+    parts = os.path.normpath(path).split(os.sep)
+    return "/".join(parts[-3:-1]) if len(parts) >= 3 else path
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("elfs", nargs="+", help="ELF files to compare, the first is the baseline")
+    parser.add_argument("--renode", action="store_true", help="also run the benchmarks under Renode")
+    args = parser.parse_args()
+
+    images = [Image(path) for path in args.elfs]
+    base = images[0]
+
+    header = f"{'bytes':<16}" + "".join(f"{label(image.path):>24}" for image in images)
+    print(header)
+    print("-" * len(header))
+    for name, attr in (("flash", "flash"), ("ram", "ram"), ("ram code", "ram_code")):
+        row = f"{name:<16}"
+        for image in images:
+            value = getattr(image, attr)
+            cell = f"{value}"
+            if image is not base and getattr(base, attr) > 0:
+                cell += f" ({100.0 * (value - getattr(base, attr)) / getattr(base, attr):+.1f}%)"
+            row += f"{cell:>24}"
+        print(row)
+
+    if args.renode:
+        print()
+        with tempfile.TemporaryDirectory() as tmp:
+            runs = []
+            for i, image in enumerate(images):
+                log = os.path.join(tmp, f"bench{i}.log")
+                run_bench(image.path, log)
+                run = Run(log, label(image.path))
+                if not run.done:
+                    sys.exit(f"{image.path}: benchmark did not finish, see Renode/run_bench.resc")
+                runs.append(run)
+            compare(runs)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())